@@ -0,0 +1,280 @@
+/*
+ * allocprof - LD_PRELOAD allocation accounting for one analyser run.
+ *
+ *     cc -O2 -shared -fPIC -o allocprof.so tools/allocprof.c -ldl
+ *     LD_PRELOAD=./allocprof.so ALLOCPROF_OUT=run.prof ./cppcheck hang60.cpp
+ *
+ * Counts every malloc/calloc/realloc/memalign family call and every
+ * free exactly (operator new and delete end up here through libstdc++),
+ * and tracks live bytes and their high-water mark by malloc_usable_size.
+ *
+ * Each time another ALLOCPROF_SAMPLE bytes (default 256 KiB) have been
+ * allocated, the calling stack is recorded together with the bytes and
+ * allocations since the previous sample, so every allocation is
+ * attributed to exactly one sampled stack, and with the live bytes at
+ * that moment. tools/allocprof.py
+ * symbolizes the stacks offline and sums them per analysis stage.
+ *
+ * Runs that time out end with SIGKILL and never reach the destructor,
+ * so nothing needed offline is left for exit: /proc/self/maps is copied
+ * at startup and after every dlopen, and the running totals follow
+ * every sample.
+ *
+ * Output (ALLOCPROF_OUT, '%p' is replaced by the pid; default
+ * allocprof.<pid>.out), one record per line:
+ *
+ *     s <bytes> <allocations> <live bytes> <return address>...
+ *     t <allocations> <frees> <bytes> <peak live bytes> <live bytes now>
+ *     m <a line of /proc/self/maps>
+ *
+ * The last 't' record holds the totals of the run.
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void *__libc_memalign(size_t, size_t);
+extern void __libc_free(void *);
+
+#define MAX_FRAMES 48
+
+static uint64_t allocations, frees, bytes, live, peak;
+static uint64_t sample_bytes, sample_allocations;
+static uint64_t interval = 256 * 1024;
+static int out = -1;
+static __thread int busy __attribute__((tls_model("initial-exec")));
+
+static void emit(const char *text, size_t size)
+{
+    while (size) {
+        const ssize_t n = write(out, text, size);
+        if (n <= 0)
+            return;
+        text += n;
+        size -= (size_t)n;
+    }
+}
+
+static void record_totals(void)
+{
+    char line[160];
+    const int len = snprintf(line, sizeof(line), "t %llu %llu %llu %llu %llu\n",
+                             (unsigned long long)__atomic_load_n(&allocations, __ATOMIC_RELAXED),
+                             (unsigned long long)__atomic_load_n(&frees, __ATOMIC_RELAXED),
+                             (unsigned long long)__atomic_load_n(&bytes, __ATOMIC_RELAXED),
+                             (unsigned long long)__atomic_load_n(&peak, __ATOMIC_RELAXED),
+                             (unsigned long long)__atomic_load_n(&live, __ATOMIC_RELAXED));
+    emit(line, (size_t)len);
+}
+
+/* One write per line, so a sample of another thread cannot split one. */
+static void copy_maps(void)
+{
+    char buffer[4096];
+    char line[4096 + 2] = "m ";
+    size_t len = 2;
+    ssize_t n, i;
+    int fd = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (i = 0; i < n; ++i) {
+            if (len < sizeof(line) - 1)
+                line[len++] = buffer[i];
+            if (buffer[i] == '\n') {
+                line[len - 1] = '\n';
+                emit(line, len);
+                len = 2;
+            }
+        }
+    }
+    close(fd);
+}
+
+static void record_stack(uint64_t sampled_bytes, uint64_t sampled_allocations, int frames_wanted)
+{
+    void *frames[MAX_FRAMES];
+    char line[32 * MAX_FRAMES + 64];
+    size_t len;
+    int n, i;
+
+    n = frames_wanted ? backtrace(frames, MAX_FRAMES) : 0;
+    len = (size_t)snprintf(line, sizeof(line), "s %llu %llu %llu", (unsigned long long)sampled_bytes,
+                           (unsigned long long)sampled_allocations,
+                           (unsigned long long)__atomic_load_n(&live, __ATOMIC_RELAXED));
+    for (i = 0; i < n && len < sizeof(line) - 24; ++i)
+        len += (size_t)snprintf(line + len, sizeof(line) - len, " %lx", (unsigned long)frames[i]);
+    line[len++] = '\n';
+    emit(line, len);
+}
+
+static void account(void *p, size_t requested)
+{
+    uint64_t total, usable;
+    if (!p)
+        return;
+    usable = malloc_usable_size(p);
+    __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&bytes, requested, __ATOMIC_RELAXED);
+    total = __atomic_add_fetch(&live, usable, __ATOMIC_RELAXED);
+    for (uint64_t old = __atomic_load_n(&peak, __ATOMIC_RELAXED); total > old;) {
+        if (__atomic_compare_exchange_n(&peak, &old, total, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+    }
+    __atomic_add_fetch(&sample_allocations, 1, __ATOMIC_RELAXED);
+    total = __atomic_add_fetch(&sample_bytes, requested, __ATOMIC_RELAXED);
+    if (out >= 0 && !busy && total >= interval) {
+        uint64_t b, a;
+        busy = 1;
+        /* Claim everything since the previous sample for this stack. */
+        b = __atomic_exchange_n(&sample_bytes, 0, __ATOMIC_RELAXED);
+        a = __atomic_exchange_n(&sample_allocations, 0, __ATOMIC_RELAXED);
+        if (b) {
+            record_stack(b, a, 1);
+            record_totals();
+        }
+        busy = 0;
+    }
+}
+
+static void release(void *p)
+{
+    if (!p)
+        return;
+    __atomic_add_fetch(&frees, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&live, malloc_usable_size(p), __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size)
+{
+    void *p = __libc_malloc(size);
+    account(p, size);
+    return p;
+}
+
+void *calloc(size_t count, size_t size)
+{
+    void *p = __libc_calloc(count, size);
+    account(p, count * size);
+    return p;
+}
+
+void *realloc(void *old, size_t size)
+{
+    void *p;
+    if (!old)
+        return malloc(size);
+    release(old);
+    p = __libc_realloc(old, size);
+    if (!p && size) {
+        /* The old block is still there. */
+        __atomic_sub_fetch(&frees, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&live, malloc_usable_size(old), __ATOMIC_RELAXED);
+        return p;
+    }
+    account(p, size);
+    return p;
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    void *p = __libc_memalign(alignment, size);
+    account(p, size);
+    return p;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **result, size_t alignment, size_t size)
+{
+    void *p = __libc_memalign(alignment, size);
+    if (!p)
+        return 12; /* ENOMEM */
+    account(p, size);
+    *result = p;
+    return 0;
+}
+
+void free(void *p)
+{
+    release(p);
+    __libc_free(p);
+}
+
+void *dlopen(const char *file, int mode)
+{
+    static void *(*real_dlopen)(const char *, int);
+    void *handle;
+    if (!real_dlopen)
+        real_dlopen = (void *(*)(const char *, int))dlsym(RTLD_NEXT, "dlopen");
+    handle = real_dlopen(file, mode);
+    if (handle && out >= 0) {
+        /* Samples from the new object need its mapping. */
+        const int was_busy = busy;
+        busy = 1;
+        copy_maps();
+        busy = was_busy;
+    }
+    return handle;
+}
+
+__attribute__((constructor)) static void start(void)
+{
+    const char *pattern = getenv("ALLOCPROF_OUT");
+    const char *sample = getenv("ALLOCPROF_SAMPLE");
+    char path[4096];
+    size_t i, len = 0;
+    void *warm[1];
+
+    if (sample && atoll(sample) > 0)
+        interval = (uint64_t)atoll(sample);
+    if (!pattern)
+        pattern = "allocprof.%p.out";
+    for (i = 0; pattern[i] && len < sizeof(path) - 24; ++i) {
+        if (pattern[i] == '%' && pattern[i + 1] == 'p') {
+            len += (size_t)snprintf(path + len, sizeof(path) - len, "%d", (int)getpid());
+            ++i;
+        } else {
+            path[len++] = pattern[i];
+        }
+    }
+    path[len] = '\0';
+    /* backtrace() loads libgcc on first use, which allocates. */
+    busy = 1;
+    backtrace(warm, 1);
+    busy = 0;
+    out = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out >= 0) {
+        busy = 1;
+        copy_maps();
+        busy = 0;
+    }
+}
+
+__attribute__((destructor)) static void finish(void)
+{
+    if (out < 0)
+        return;
+    busy = 1;
+    /* The tail since the last sample has no stack of its own. */
+    if (sample_bytes)
+        record_stack(sample_bytes, sample_allocations, 0);
+    record_totals();
+    close(out);
+    out = -1;
+}
@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+"""Allocation counts, bytes and live high-water marks per analysis stage.
+
+Runs each file with tools/allocprof.c preloaded, symbolizes the sampled
+allocation stacks with addr2line and assigns every sample to the stage
+of its innermost analyser frame (hangcorpus.hang_stage, so the
+Token::insertToken / TokenList primitives count for their caller, e.g.
+TemplateSimplifier::expandTemplate -> templates). Totals, frees and the
+overall peak are exact; the per-stage split is as fine as the sampling
+interval, and a stage's peak is the highest live byte count seen at
+one of its samples:
+
+    cc -O2 -shared -fPIC -o allocprof.so tools/allocprof.c -ldl
+    tools/allocprof.py --binary ./cppcheck --lib ./allocprof.so hang16.cpp hang51.cpp hang60.cpp
+    tools/allocprof.py --binary ./cppcheck --lib ./allocprof.so --json alloc.json
+
+The binary needs debug information for the stage split. Runs killed at
+--timeout keep their samples and the totals up to the last sample.
+"""
+
+import argparse
+import collections
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+import hangcorpus
+
+_SOURCE = re.compile(r'(?:^|/)((?:lib|cli|externals)/[^:]*)$')
+_ET_EXEC = 2
+
+
+def parse_profile(path):
+    """Return (samples, totals, maps) of one allocprof.c output file."""
+    samples = []
+    totals = None
+    maps = {}
+    with open(path) as f:
+        for line in f:
+            if line.startswith('m '):
+                # Copies from startup and each dlopen; mappings repeat.
+                fields = line[2:].split(None, 5)
+                if len(fields) == 6 and 'x' in fields[1]:
+                    start, end = (int(a, 16) for a in fields[0].split('-'))
+                    maps[(start, end)] = (start, end, int(fields[2], 16), fields[5].strip())
+            elif line.startswith('s '):
+                fields = line.split()
+                samples.append((int(fields[1]), int(fields[2]), int(fields[3]),
+                                [int(a, 16) for a in fields[4:]]))
+            elif line.startswith('t '):
+                # Running totals; the last record is the final one.
+                keys = ('allocations', 'frees', 'bytes', 'peak_live', 'live_at_exit')
+                totals = dict(zip(keys, (int(v) for v in line.split()[1:])))
+    return samples, totals, sorted(maps.values())
+
+
+def is_exec(module, cache={}):
+    if module not in cache:
+        try:
+            with open(module, 'rb') as f:
+                header = f.read(18)
+            cache[module] = header[:4] == b'\x7fELF' and header[16] == _ET_EXEC
+        except OSError:
+            cache[module] = False
+    return cache[module]
+
+
+class Symbolizer(object):
+    """addr2line with a cache keyed by (module, address in the module)."""
+
+    def __init__(self):
+        self.cache = {}
+
+    def frames(self, addresses, maps):
+        wanted = collections.defaultdict(set)
+        located = []
+        for address in addresses:
+            for start, end, offset, module in maps:
+                if start <= address < end:
+                    if os.path.basename(module).startswith('allocprof'):
+                        break
+                    # Return addresses point after the call.
+                    vaddr = address - 1 if is_exec(module) else address - 1 - start + offset
+                    located.append((module, vaddr))
+                    if (module, vaddr) not in self.cache:
+                        wanted[module].add(vaddr)
+                    break
+        for module, vaddrs in wanted.items():
+            self._resolve(module, sorted(vaddrs))
+        return [frame for key in located for frame in self.cache[key]]
+
+    def _resolve(self, module, vaddrs):
+        """Cache the frames of each address, inlined callers included."""
+        try:
+            proc = subprocess.run(['addr2line', '-a', '-i', '-C', '-f', '-e', module],
+                                  input='\n'.join('0x%x' % a for a in vaddrs).encode(),
+                                  stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+            lines = proc.stdout.decode('utf-8', 'replace').splitlines()
+        except OSError:
+            lines = []
+        for vaddr in vaddrs:
+            self.cache[(module, vaddr)] = []
+        frames = None
+        for line in lines:
+            if line.startswith('0x'):
+                frames = self.cache.get((module, int(line, 16)))
+                function = None
+            elif frames is not None and function is None:
+                function = line
+            elif frames is not None:
+                source, _, number = line.rpartition(':')
+                number = number.split()[0] if number else ''
+                m = _SOURCE.search(source)
+                frames.append(hangcorpus.Frame(
+                    function, m.group(1) if m else (source if source != '??' else None),
+                    int(number) if number.isdigit() else None))
+                function = None
+
+
+def profile(options, path, symbolizer):
+    with tempfile.TemporaryDirectory() as tmp:
+        env = dict(os.environ, LD_PRELOAD=os.path.abspath(options.lib),
+                   ALLOCPROF_OUT=os.path.join(tmp, '%p.prof'),
+                   ALLOCPROF_SAMPLE=str(options.sample))
+        result = hangcorpus.run(options.binary, path, options.args, timeout=options.timeout, env=env)
+        stages = collections.defaultdict(lambda: {'allocations': 0, 'bytes': 0, 'peak_live': 0})
+        totals = collections.Counter()
+        for name in sorted(os.listdir(tmp)):
+            samples, process_totals, maps = parse_profile(os.path.join(tmp, name))
+            for key, value in (process_totals or {}).items():
+                totals[key] = max(totals[key], value) if key == 'peak_live' else totals[key] + value
+            for sampled_bytes, allocations, live, addresses in samples:
+                frames = symbolizer.frames(addresses, maps)
+                stage = hangcorpus.hang_stage(frames) or 'other'
+                entry = stages[stage]
+                entry['allocations'] += allocations
+                entry['bytes'] += sampled_bytes
+                entry['peak_live'] = max(entry['peak_live'], live)
+    return {'status': result.status, 'wall': round(result.wall, 3), 'totals': dict(totals),
+            'stages': dict(stages)}
+
+
+def mib(n):
+    return n / 1048576.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--binary', required=True, help='cppcheck binary')
+    parser.add_argument('--lib', required=True, help='allocprof.so built from tools/allocprof.c')
+    parser.add_argument('--sample', type=int, default=256 * 1024, help='bytes between stack samples')
+    parser.add_argument('--timeout', type=float, default=120.0, help='seconds per file')
+    parser.add_argument('--json', metavar='FILE', help='write the per-file report as JSON')
+    parser.add_argument('files', nargs='*', help='inputs (default: the whole corpus)')
+    argv = sys.argv[1:]
+    args = []
+    if '--' in argv:
+        args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    options = parser.parse_args(argv)
+    options.args = args
+
+    symbolizer = Symbolizer()
+    report = {}
+    corpus = collections.defaultdict(collections.Counter)
+    print('%-12s %-15s %12s %10s %10s' % ('file', 'stage', 'allocations', 'MiB', 'peak MiB'))
+    for path in options.files or hangcorpus.corpus_files():
+        name = os.path.basename(path)
+        data = report[name] = profile(options, path, symbolizer)
+        for stage, entry in sorted(data['stages'].items(), key=lambda i: -i[1]['bytes']):
+            print('%-12s %-15s %12d %10.1f %10.1f' % (name, stage, entry['allocations'],
+                                                      mib(entry['bytes']), mib(entry['peak_live'])))
+            corpus[stage]['allocations'] += entry['allocations']
+            corpus[stage]['bytes'] += entry['bytes']
+        totals = data['totals']
+        if totals:
+            print('%-12s %-15s %12d %10.1f %10.1f  (%d frees, %s)' % (
+                name, 'total', totals['allocations'], mib(totals['bytes']), mib(totals['peak_live']),
+                totals['frees'], data['status']))
+        sys.stdout.flush()
+
+    if len(report) > 1:
+        print()
+        for stage, entry in sorted(corpus.items(), key=lambda i: -i[1]['bytes']):
+            print('%-12s %-15s %12d %10.1f' % ('corpus', stage, entry['allocations'], mib(entry['bytes'])))
+    if options.json:
+        with open(options.json, 'w') as f:
+            json.dump(report, f, indent=1, sort_keys=True)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""Gate a change on statistically significant slowdowns between two builds.
+
+Every file is run --runs times on both builds, in pairs whose order is
+randomised, so drift of a shared box (thermal throttling, a neighbour's
+compile) hits both builds alike. A file regressed when
+
+  - the Mann-Whitney U test rejects equal distributions at --alpha,
+  - the bootstrap confidence interval of median(new) / median(old)
+    lies entirely above 1 + --min-change,
+
+and is reported with the median ratio, its interval and Cliff's delta
+as the effect size (+1: every new run slower than every old one).
+Anything else is noise and stays quiet, which catches the 10-20%
+regressions on mid-size files such as hang2.cpp and hang76.cpp that
+eyeballing two runs misses:
+
+    tools/benchcmp.py --old ./cppcheck-main --new ./cppcheck hang2.cpp hang76.cpp
+    tools/benchcmp.py --old a/cppcheck --new b/cppcheck --runs 25 $(tools/changeselect.py select --diff my.patch)
+    tools/benchcmp.py --old a/cppcheck --new b/cppcheck --perf ./perfstat --min-change 0.01
+
+The metric is CPU time, or user-space instructions from tools/perfstat.c
+with --perf. A file that times out, crashes or fails on the new build
+while the old one finishes counts as a regression, since the samples of
+a run that died early say nothing about its speed; one the old build
+cannot finish either is skipped. A crash or error of the old build
+aborts the comparison. Exits with 1 when any file regressed, 2 when
+aborted.
+"""
+
+import argparse
+import json
+import os
+import random
+import statistics
+import sys
+import tempfile
+
+import benchstats
+import hangcorpus
+
+
+def measure(options, binary, path):
+    """(status, one sample of the metric); the sample is None unless the
+    run was 'ok'."""
+    if not options.perf:
+        result = hangcorpus.run(binary, path, options.args, timeout=options.timeout)
+        return result.status, result.cpu if result.status == 'ok' else None
+    with tempfile.TemporaryDirectory() as tmp:
+        counts = os.path.join(tmp, 'counts.json')
+        result = hangcorpus.run(options.perf, path, ['-o', counts, '--', binary] + options.args,
+                                timeout=options.timeout)
+        counters = hangcorpus.read_perfstat(counts)
+    if result.status != 'ok':
+        return result.status, None
+    if not counters or 'instructions' not in counters['total']:
+        raise RuntimeError('%s: %s counted no instructions' % (path, options.perf))
+    return result.status, float(counters['total']['instructions'])
+
+
+def compare(options, path, rng):
+    builds = (('old', options.old), ('new', options.new))
+    for _, binary in builds:
+        for _ in range(options.warmup):
+            measure(options, binary, path)
+    samples = {'old': [], 'new': []}
+    for _ in range(options.runs):
+        failed = {}
+        for name, binary in rng.sample(builds, 2):
+            status, value = measure(options, binary, path)
+            if value is None:
+                failed[name] = status
+            else:
+                samples[name].append(value)
+        if failed.get('old') not in (None, 'timeout'):
+            raise RuntimeError('%s: %s on the old build' % (path, failed['old']))
+        if failed.get('new') not in (None, 'timeout'):
+            return {'status': failed['new'], 'build': 'new'}
+        if len(failed) == 2:
+            return {'status': 'skipped'}
+        if failed:
+            # One build finished within the timeout the other one exceeds.
+            return {'status': 'timeout', 'build': list(failed)[0]}
+    old, new = samples['old'], samples['new']
+    _, p = benchstats.mann_whitney_u(new, old)
+    ratio, lo, hi = benchstats.bootstrap_ratio_ci(new, old, options.confidence, rng=rng)
+    if p < options.alpha and lo > 1 + options.min_change:
+        verdict = 'regression'
+    elif p < options.alpha and hi < 1 - options.min_change:
+        verdict = 'improvement'
+    else:
+        verdict = 'same'
+    return {'status': verdict, 'p': p, 'ratio': ratio, 'ci': [lo, hi],
+            'delta': benchstats.cliffs_delta(new, old),
+            'old_median': statistics.median(old), 'new_median': statistics.median(new),
+            'old': old, 'new': new}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--old', required=True, help='baseline cppcheck binary')
+    parser.add_argument('--new', required=True, help='candidate cppcheck binary')
+    parser.add_argument('--runs', type=int, default=15, help='runs per build and file')
+    parser.add_argument('--warmup', type=int, default=1, help='unmeasured runs per build and file')
+    parser.add_argument('--alpha', type=float, default=0.01, help='significance level')
+    parser.add_argument('--confidence', type=float, default=0.95, help='bootstrap interval')
+    parser.add_argument('--min-change', type=float, default=0.02,
+                        help='smallest relative change worth reporting')
+    parser.add_argument('--perf', metavar='PERFSTAT',
+                        help='compare instructions counted by this tools/perfstat.c binary')
+    parser.add_argument('--timeout', type=float, default=60.0, help='seconds per run')
+    parser.add_argument('--seed', type=int, default=0, help='seed of the run order')
+    parser.add_argument('--json', metavar='FILE', help='write all samples and results')
+    parser.add_argument('--all', action='store_true', help='also print unchanged files')
+    parser.add_argument('files', nargs='*', help='inputs (default: the whole corpus)')
+    argv = sys.argv[1:]
+    args = []
+    if '--' in argv:
+        args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    options = parser.parse_args(argv)
+    options.args = args
+    if not 0 < options.alpha < 1:
+        parser.error('--alpha must be between 0 and 1')
+    min_runs = benchstats.mann_whitney_min_n(options.alpha)
+    if options.runs < min_runs:
+        parser.error('--runs below %d cannot reach significance at --alpha %g' % (min_runs, options.alpha))
+
+    rng = random.Random(options.seed)
+    unit = 'instr' if options.perf else 's'
+    report = {}
+    regressions = 0
+    for path in options.files or hangcorpus.corpus_files():
+        name = os.path.basename(path)
+        try:
+            result = report[name] = compare(options, path, rng)
+        except RuntimeError as e:
+            print('aborted: %s' % e)
+            return 2
+        if result['status'] == 'timeout':
+            print('%-12s %-11s timeout on the %s build only' % (
+                name, 'regression' if result['build'] == 'new' else 'improvement', result['build']))
+        elif result['status'] in ('crash', 'error'):
+            print('%-12s %-11s %s on the new build' % (name, 'regression', result['status']))
+        elif result['status'] == 'skipped':
+            print('%-12s timeout on both builds, skipped' % name)
+        elif result['status'] != 'same' or options.all:
+            print('%-12s %-11s %+6.1f%% [%+.1f%%, %+.1f%%]  p=%.2g  delta=%+.2f  %.4g -> %.4g %s' % (
+                name, result['status'], 100 * (result['ratio'] - 1), 100 * (result['ci'][0] - 1),
+                100 * (result['ci'][1] - 1), result['p'], result['delta'],
+                result['old_median'], result['new_median'], unit))
+        regressions += result['status'] == 'regression' or result.get('build') == 'new'
+        sys.stdout.flush()
+    print('%d files, %d significant regressions' % (len(report), regressions))
+    if options.json:
+        with open(options.json, 'w') as f:
+            json.dump(report, f, indent=1, sort_keys=True)
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
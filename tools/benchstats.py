@@ -0,0 +1,125 @@
+"""Statistics shared by the benchmark tools.
+
+Only the standard library: the benchmark boxes have no numpy.
+"""
+
+import collections
+import math
+import random
+import statistics
+
+
+def fit_exponent(points):
+    """Least-squares fit of t = c * n**k on a log-log scale.
+
+    points is [(n, t)] with n, t > 0. Returns (k, r2), or (None, None)
+    with fewer than two usable points.
+    """
+    xs = [math.log(n) for n, t in points if n > 0 and t > 0]
+    ys = [math.log(t) for n, t in points if n > 0 and t > 0]
+    if len(xs) < 2:
+        return None, None
+    mx = sum(xs) / len(xs)
+    my = sum(ys) / len(ys)
+    sxx = sum((x - mx) ** 2 for x in xs)
+    if not sxx:
+        return None, None
+    sxy = sum((x - mx) * (y - my) for x, y in zip(xs, ys))
+    syy = sum((y - my) ** 2 for y in ys)
+    k = sxy / sxx
+    r2 = sxy * sxy / (sxx * syy) if syy else 1.0
+    return k, r2
+
+
+def t_quantile(df, confidence=0.95):
+    """Two-sided critical value of Student's t with df degrees of freedom.
+
+    Exact for df = 1 (Cauchy) and df = 2, where the expansion is far off
+    (11.30 for 12.71 at df = 1); above that the Cornish-Fisher expansion
+    around the normal quantile (Abramowitz and Stegun 26.7.5), within 1%
+    of the tables for confidences up to 0.99.
+    """
+    p = 0.5 + confidence / 2
+    if df == 1:
+        return math.tan(math.pi * (p - 0.5))
+    if df == 2:
+        return (2 * p - 1) / math.sqrt(2 * p * (1 - p))
+    z = statistics.NormalDist().inv_cdf(p)
+    return (z + (z ** 3 + z) / (4 * df)
+            + (5 * z ** 5 + 16 * z ** 3 + 3 * z) / (96 * df ** 2)
+            + (3 * z ** 7 + 19 * z ** 5 + 17 * z ** 3 - 15 * z) / (384 * df ** 3)
+            + (79 * z ** 9 + 776 * z ** 7 + 1482 * z ** 5 - 1920 * z ** 3 - 945 * z)
+            / (92160 * df ** 4))
+
+
+def mean_ci(samples, confidence=0.95):
+    """(mean, half width of the t confidence interval) of samples."""
+    mean = statistics.mean(samples)
+    if len(samples) < 2:
+        return mean, float('inf')
+    return mean, t_quantile(len(samples) - 1, confidence) * statistics.stdev(samples) / math.sqrt(len(samples))
+
+
+def ranks(values):
+    """Average ranks (1-based) of values, ties sharing their mean rank."""
+    order = sorted(range(len(values)), key=values.__getitem__)
+    result = [0.0] * len(values)
+    i = 0
+    while i < len(order):
+        j = i
+        while j + 1 < len(order) and values[order[j + 1]] == values[order[i]]:
+            j += 1
+        for k in range(i, j + 1):
+            result[order[k]] = (i + j) / 2.0 + 1
+        i = j + 1
+    return result
+
+
+def mann_whitney_u(a, b):
+    """Mann-Whitney U test of a against b.
+
+    Returns (U of a, two-sided p). The p value uses the normal
+    approximation with tie correction, adequate from about eight
+    samples per side.
+    """
+    n1, n2 = len(a), len(b)
+    r = ranks(list(a) + list(b))
+    u = sum(r[:n1]) - n1 * (n1 + 1) / 2.0
+    n = n1 + n2
+    ties = collections.Counter(r)
+    tie_term = sum(t ** 3 - t for t in ties.values()) / float(n * (n - 1)) if n > 1 else 0.0
+    sigma = math.sqrt(n1 * n2 / 12.0 * ((n + 1) - tie_term))
+    if not sigma:
+        return u, 1.0
+    z = (abs(u - n1 * n2 / 2.0) - 0.5) / sigma
+    return u, min(1.0, 2 * (1 - statistics.NormalDist().cdf(max(z, 0.0))))
+
+
+def mann_whitney_min_n(alpha):
+    """Smallest samples per side whose most extreme outcome, no overlap at
+    all, has a mann_whitney_u p below alpha (6 for alpha = 0.01)."""
+    n = 2
+    while mann_whitney_u(range(n), range(n, 2 * n))[1] >= alpha:
+        n += 1
+    return n
+
+
+def cliffs_delta(a, b):
+    """P(a > b) - P(a < b); +1 when every a exceeds every b."""
+    u, _ = mann_whitney_u(a, b)
+    return 2.0 * u / (len(a) * len(b)) - 1
+
+
+def bootstrap_ratio_ci(a, b, confidence=0.95, iterations=2000, rng=None):
+    """median(a) / median(b) with a percentile bootstrap interval."""
+    rng = rng or random.Random(0)
+    ratios = []
+    for _ in range(iterations):
+        ma = statistics.median(rng.choices(a, k=len(a)))
+        mb = statistics.median(rng.choices(b, k=len(b)))
+        if mb > 0:
+            ratios.append(ma / mb)
+    ratios.sort()
+    lo = ratios[int((1 - confidence) / 2 * len(ratios))]
+    hi = ratios[min(len(ratios) - 1, int((1 + confidence) / 2 * len(ratios)))]
+    return statistics.median(a) / statistics.median(b), lo, hi
@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""Corpus slowdown of debug-STL and sanitizer builds against release.
+
+Backtraces such as hang61.cpp's and hang72.cpp's are full of
+__gnu_debug::_Safe_iterator and _Safe_sequence_base::_M_get_mutex
+frames: they were taken on _GLIBCXX_DEBUG builds, and some of those
+"hangs" may be nothing but checked-container overhead. This runs every
+file on each build with the same timeout and reports the CPU time of
+each build as a factor of the reference build (the first --build
+unless --reference says otherwise):
+
+    make clean && make -j8 CXXFLAGS="-O2" && mv cppcheck cppcheck-release
+    make clean && make -j8 CXXFLAGS="-O2 -D_GLIBCXX_DEBUG" && mv cppcheck cppcheck-debug
+    make clean && make -j8 CXXFLAGS="-O1 -g -fsanitize=address,undefined" \\
+        LDFLAGS="-fsanitize=address,undefined" && mv cppcheck cppcheck-asan
+    tools/buildmatrix.py --build release=./cppcheck-release \\
+        --build debug=./cppcheck-debug --build asan=./cppcheck-asan --json matrix.json
+
+A file that times out on some builds but not on the reference is
+marked "<build>-only hang", so a _GLIBCXX_DEBUG-only hang is not
+chased as an analyser bug. A run that crashes or exits with an error
+(a sanitizer finding, a _GLIBCXX_DEBUG assertion) is marked the same
+way, "asan-only error" or "debug-only crash", its truncated time is not
+compared, and the first line of its report is printed below the row. A slowdown above --outlier times the
+build's corpus median marks a file whose cost is concentrated where
+the build adds most, e.g. iterator-heavy loops under the debug
+containers. "debug bt" flags files whose recorded backtrace
+(hangcorpus.embedded_backtrace) has debug-container frames.
+"""
+
+import argparse
+import json
+import math
+import os
+import statistics
+import sys
+
+import hangcorpus
+
+MIN_SECONDS = 0.01
+_DEBUG_FRAMES = ('__gnu_debug::', '_Safe_sequence_base', '_Safe_iterator')
+# First lines of sanitizer and debug-mode container reports.
+_FINDINGS = ('ERROR: AddressSanitizer', 'ERROR: LeakSanitizer', 'runtime error:',
+             'error: attempt to', 'Assertion')
+
+
+def parse_build(text):
+    name, sep, binary = text.partition('=')
+    if not sep or not name or not binary:
+        raise argparse.ArgumentTypeError('expected NAME=BINARY, got %r' % text)
+    return name, binary
+
+
+def finding(stderr):
+    for line in stderr.splitlines():
+        if any(marker in line for marker in _FINDINGS):
+            return line.strip()
+    return None
+
+
+def measure(options, binary, path):
+    """(status, median CPU seconds of --runs runs or None, finding) of
+    the first run that is not 'ok', else of all of them."""
+    seconds = []
+    for _ in range(options.runs):
+        result = hangcorpus.run(binary, path, options.args, timeout=options.timeout, env=options.env)
+        if result.status != 'ok':
+            return result.status, None, finding(result.stderr)
+        seconds.append(result.cpu)
+    return 'ok', statistics.median(seconds), None
+
+
+def debug_backtrace(path):
+    text = hangcorpus.embedded_backtrace(path)
+    return any(frame in text for frame in _DEBUG_FRAMES)
+
+
+_FAILURE = {'timeout': 'hang', 'crash': 'crash', 'error': 'error'}
+
+
+def verdict(statuses, reference):
+    if statuses[reference] != 'ok':
+        return _FAILURE[statuses[reference]]
+    failed = {}
+    for name, status in statuses.items():
+        if status != 'ok':
+            failed.setdefault(_FAILURE[status], []).append(name)
+    return ', '.join('%s-only %s' % (','.join(names), failure)
+                     for failure, names in sorted(failed.items()))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--build', action='append', type=parse_build, required=True,
+                        metavar='NAME=BINARY', help='a build to run (repeat; two or more)')
+    parser.add_argument('--reference', help='build the factors are relative to (default: the first)')
+    parser.add_argument('--runs', type=int, default=1, help='runs per build and file, median taken')
+    parser.add_argument('--timeout', type=float, default=60.0, help='seconds per run, all builds')
+    parser.add_argument('--outlier', type=float, default=3.0,
+                        help='flag slowdowns above this many times the build median')
+    parser.add_argument('--json', metavar='FILE', help='write the matrix as JSON')
+    parser.add_argument('files', nargs='*', help='inputs (default: the whole corpus)')
+    argv = sys.argv[1:]
+    args = []
+    if '--' in argv:
+        args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    options = parser.parse_args(argv)
+    options.args = args
+    builds = options.build
+    names = [name for name, _ in builds]
+    if len(builds) < 2 or len(set(names)) != len(names):
+        parser.error('need at least two --build options with distinct names')
+    reference = options.reference or names[0]
+    if reference not in names:
+        parser.error('--reference %s is not a --build' % reference)
+    # Leak reports and their exit code would make every sanitizer run an 'error'.
+    options.env = dict(os.environ)
+    options.env.setdefault('ASAN_OPTIONS', 'detect_leaks=0')
+    options.env.setdefault('UBSAN_OPTIONS', 'print_stacktrace=1')
+
+    others = [name for name in names if name != reference]
+    report = {}
+    print('%-12s %10s' % ('file', reference) + ''.join(' %14s' % name for name in others) + '  verdict')
+    for path in options.files or hangcorpus.corpus_files():
+        name = os.path.basename(path)
+        runs = dict((build, measure(options, binary, path)) for build, binary in builds)
+        statuses = dict((build, run[0]) for build, run in runs.items())
+        times = dict((build, run[1]) for build, run in runs.items())
+        findings = dict((build, run[2]) for build, run in runs.items() if run[2])
+        factors = {}
+        for build in others:
+            if times[reference] is not None and times[reference] >= MIN_SECONDS and times[build]:
+                factors[build] = times[build] / times[reference]
+        report[name] = {'seconds': times, 'status': statuses, 'findings': findings,
+                        'factors': factors, 'verdict': verdict(statuses, reference),
+                        'debug_backtrace': debug_backtrace(path)}
+        cells = []
+        for build in others:
+            if times[build] is None:
+                cells.append(statuses[build])
+            elif build in factors:
+                cells.append('%.2fs %5.1fx' % (times[build], factors[build]))
+            else:
+                cells.append('%.2fs' % times[build])
+        line = '%-12s %10s' % (name, statuses[reference] if times[reference] is None
+                               else '%.2fs' % times[reference])
+        line += ''.join(' %14s' % cell for cell in cells)
+        line += '  %s%s' % (report[name]['verdict'], ' (debug bt)' if report[name]['debug_backtrace'] else '')
+        print(line.rstrip())
+        for build in names:
+            if build in findings:
+                print('%-12s %s: %s' % ('', build, findings[build]))
+        sys.stdout.flush()
+
+    print()
+    summary = {}
+    for build in others:
+        factors = [data['factors'][build] for data in report.values() if build in data['factors']]
+        only = sorted('%s (%s)' % (name, data['status'][build]) for name, data in report.items()
+                      if data['status'][reference] == 'ok' and data['status'][build] != 'ok')
+        if not factors:
+            summary[build] = {'compared': 0, 'only_failures': only}
+            print('%-10s no file long enough on %s to compare' % (build, reference))
+            if only:
+                print('%-10s fails only here: %s' % ('', ' '.join(only)))
+            continue
+        median = statistics.median(factors)
+        outliers = sorted(name for name, data in report.items()
+                          if data['factors'].get(build, 0.0) > options.outlier * median)
+        summary[build] = {'median': median,
+                          'geomean': math.exp(sum(math.log(f) for f in factors) / len(factors)),
+                          'max': max(factors), 'compared': len(factors),
+                          'only_failures': only, 'outliers': outliers}
+        print('%-10s median %.2fx, geomean %.2fx, max %.2fx over %d files' % (
+            build, median, summary[build]['geomean'], max(factors), len(factors)))
+        if only:
+            print('%-10s fails only here: %s' % ('', ' '.join(only)))
+        if outliers:
+            print('%-10s above %.1fx the median: %s' % ('', options.outlier, ' '.join(outliers)))
+    if options.json:
+        with open(options.json, 'w') as f:
+            json.dump({'reference': reference, 'builds': dict(builds), 'timeout': options.timeout,
+                       'summary': summary, 'files': report}, f, indent=1, sort_keys=True)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
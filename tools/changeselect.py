@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""Pick the corpus files a cppcheck change should run first.
+
+'learn' builds selection.json, a map from analyser sources (lib/*.cpp)
+to corpus files with a weight per pair, from up to four sources of
+evidence, strongest first:
+
+  backtraces   frames of the backtrace recorded with a file, innermost
+               frames weighing most (hang60 -> lib/templatesimplifier.cpp)
+  coverage     edges per source file, from a tools/cmin.py --coverage
+               file symbolized against the same coverage binary
+  stages       the manifest stage of a file, mapped to the sources of
+               that stage
+  keywords     files using a construct that only one stage handles
+               ('template' -> templates), for the many files without a
+               backtrace or a recorded stage (hang7, hang9, hang13, ...)
+
+'select' reads a unified diff (or file names) and prints the corpus
+files touching the changed sources, best first:
+
+    tools/changeselect.py learn --coverage coverage.json --binary ./cppcheck-cov
+    git -C ../cppcheck diff HEAD~1 | tools/changeselect.py select --diff -
+    tools/changeselect.py select lib/templatesimplifier.cpp --limit 12
+    tools/runcorpus.py --binary ./cppcheck $(tools/changeselect.py select --diff my.patch)
+"""
+
+import argparse
+import collections
+import json
+import os
+import re
+import subprocess
+import sys
+
+import hangcorpus
+from manifest import Manifest
+
+SELECTION = os.path.join(hangcorpus.CORPUS_DIR, 'selection.json')
+
+BACKTRACE_WEIGHT = 100.0
+COVERAGE_WEIGHT = 10.0
+STAGE_WEIGHT = 1.0
+KEYWORD_WEIGHT = 0.5
+
+KEYWORD_STAGES = (
+    ('template', 'templates'),
+)
+
+_SOURCE_ROOT = re.compile(r'(?:^|/)((?:lib|cli|externals)/.*)$')
+
+
+def source_key(path):
+    """'/home/u/cppcheck/lib/token.h' -> 'lib/token'; None outside the analyser."""
+    m = _SOURCE_ROOT.search(path.replace('\\', '/'))
+    if not m:
+        return None
+    return os.path.splitext(m.group(1))[0]
+
+
+def symbolize(binary, offsets):
+    """Map module offsets of binary to source keys with one addr2line run."""
+    offsets = sorted(offsets)
+    if not offsets:
+        return {}
+    proc = subprocess.run(['addr2line', '-e', binary],
+                          input='\n'.join('0x%x' % o for o in offsets).encode(),
+                          stdout=subprocess.PIPE, check=True)
+    lines = proc.stdout.decode('utf-8', 'replace').splitlines()
+    return dict((o, source_key(line.rsplit(':', 1)[0])) for o, line in zip(offsets, lines))
+
+
+def stage_keys(stage):
+    """Selection keys of the sources of a stage, e.g. 'lib/templatesimplifier*'."""
+    for name, prefixes in hangcorpus.STAGE_SOURCES:
+        if name == stage:
+            return [prefix.rstrip('./') + '*' for prefix in prefixes]
+    return []
+
+
+def learn(options):
+    weights = collections.defaultdict(collections.Counter)
+    manifest = Manifest()
+
+    for path in hangcorpus.corpus_files():
+        name = os.path.basename(path)
+        frames = hangcorpus.parse_backtrace(hangcorpus.embedded_backtrace(path))
+        for depth, frame in enumerate(frames):
+            key = source_key(frame.source or '')
+            if key:
+                weights[key][name] += BACKTRACE_WEIGHT / (depth + 1)
+        entry = manifest.entry(name)
+        if entry and entry['stage']:
+            for key in stage_keys(entry['stage']):
+                weights[key][name] += STAGE_WEIGHT
+        words = set(t.str for t in hangcorpus.tokenize(hangcorpus.read_source(path)) if t.kind == 'name')
+        for word, stage in KEYWORD_STAGES:
+            if word in words:
+                for key in stage_keys(stage):
+                    weights[key][name] += KEYWORD_WEIGHT
+
+    if options.coverage:
+        with open(options.coverage) as f:
+            coverage = json.load(f)
+        module = os.path.basename(options.binary)
+        per_file = {}
+        for name, info in coverage.items():
+            per_file[name] = [int(e.split('+', 1)[1], 16) for e in info['edges']
+                              if e.split('+', 1)[0] == module]
+        where = symbolize(options.binary, set(o for edges in per_file.values() for o in edges))
+        edges_per_source = collections.Counter(where[o] for o in where if where[o])
+        for name, edges in per_file.items():
+            hits = collections.Counter(where[o] for o in edges if where.get(o))
+            for key, count in hits.items():
+                # Share of the source's known edges this file reaches.
+                weights[key][name] += COVERAGE_WEIGHT * count / edges_per_source[key]
+
+    with open(options.selection, 'w') as f:
+        json.dump({'sources': dict((k, dict((n, round(w, 4)) for n, w in v.items()))
+                               for k, v in sorted(weights.items()))}, f, indent=1, sort_keys=True)
+    print('%d sources mapped to corpus files -> %s' % (len(weights), options.selection))
+
+
+def changed_sources(options):
+    names = list(options.files)
+    if options.diff:
+        diff = sys.stdin if options.diff == '-' else open(options.diff)
+        for line in diff:
+            if line.startswith('+++ ') or line.startswith('--- '):
+                path = line[4:].strip().split('\t')[0]
+                if path != '/dev/null':
+                    names.append(re.sub(r'^[ab]/', '', path))
+    return set(filter(None, (source_key(n) for n in names)))
+
+
+def select(options):
+    with open(options.selection) as f:
+        sources = json.load(f)['sources']
+    changed = changed_sources(options)
+    scores = collections.Counter()
+    for key in changed:
+        for candidate, table in sources.items():
+            # Stage keys such as 'lib/check*' match every source they prefix.
+            if key == candidate or (candidate.endswith('*') and key.startswith(candidate[:-1])):
+                scores.update(table)
+    corpus = dict((os.path.basename(p), p) for p in hangcorpus.corpus_files())
+    ranked = sorted((n for n in scores if n in corpus),
+                    key=lambda n: (-scores[n], os.path.getsize(corpus[n]), n))
+    if options.limit:
+        ranked = ranked[:options.limit]
+    if options.all:
+        rest = [n for n in sorted(corpus, key=lambda n: os.path.getsize(corpus[n])) if n not in ranked]
+        ranked += rest
+    for name in ranked:
+        if options.scores:
+            print('%10.2f  %s' % (scores[name], corpus[name]))
+        else:
+            print(corpus[name])
+    if not changed:
+        sys.stderr.write('no analyser sources in the change\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--selection', default=SELECTION, help='map file (default %(default)s)')
+    sub = parser.add_subparsers(dest='command', required=True)
+    p = sub.add_parser('learn', help='build the source -> corpus map')
+    p.add_argument('--coverage', help='per-file coverage from tools/cmin.py --coverage')
+    p.add_argument('--binary', help='the coverage binary the edges belong to')
+    p = sub.add_parser('select', help='list corpus files for a change')
+    p.add_argument('--diff', help="unified diff file, '-' for stdin")
+    p.add_argument('--limit', type=int, help='print at most this many files')
+    p.add_argument('--all', action='store_true', help='append the unselected files, smallest first')
+    p.add_argument('--scores', action='store_true', help='print the score of each file')
+    p.add_argument('files', nargs='*', help='changed analyser sources')
+    options = parser.parse_args()
+
+    if options.command == 'learn':
+        if options.coverage and not options.binary:
+            parser.error('--coverage needs --binary')
+        learn(options)
+    else:
+        select(options)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
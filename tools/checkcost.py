@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""Per-check cost of --enable=all across the corpus.
+
+Every file is analysed with --enable=all --showtime=summary, and the
+runChecks and runSimplifiedChecks timer of each Check class is
+recorded, so extended checks such as CheckOther's (hang10.cpp,
+hang91.cpp) get a price. The summary table ranks the checks by their
+corpus-wide seconds, with their share of all check time and of the
+whole analysis, the number of files on which each was the most
+expensive check and its worst file; it answers which checks to leave
+out of a latency-sensitive pipeline:
+
+    tools/checkcost.py --binary ./cppcheck
+    tools/checkcost.py --binary ./cppcheck --per-file 5 hang10.cpp hang91.cpp -- --inconclusive
+    tools/checkcost.py --binary ./cppcheck --backtrace --json checkcost.json
+
+A file that times out has no timers. With --backtrace the innermost
+check frame of a gdb backtrace taken before the kill names the check it
+hung in (hang91.cpp: CheckOther::checkRedundantAssignment), and the
+table counts those hangs per check. Helper classes a check runs through
+count as that check (_FRAME_CHECKS: hang67.cpp hangs in
+UninitVar::parse under ExecutionPath::checkScope, i.e. in
+CheckUninitVar).
+"""
+
+import argparse
+import collections
+import json
+import os
+import re
+import sys
+
+import hangcorpus
+
+PARTS = ('runChecks', 'runSimplifiedChecks')
+_TIMER = re.compile(r'^(?:Check)?(\w+)::(runChecks|runSimplifiedChecks)$')
+_METHOD = re.compile(r'(\w+)::(~?\w+)$')
+_TEMPLATE_ARGS = re.compile(r'<[^<>]*>')
+# Classes outside the Check hierarchy whose frames belong to a check.
+_FRAME_CHECKS = {
+    'UninitVar': 'CheckUninitVar',
+    'ExecutionPath': 'CheckUninitVar',
+}
+
+
+def check_times(timers):
+    """{check class: {part: seconds}} from parsed --showtime timers."""
+    checks = collections.defaultdict(dict)
+    for name, seconds in timers.items():
+        m = _TIMER.match(name)
+        if m:
+            checks['Check' + m.group(1)][m.group(2)] = seconds
+    return dict(checks)
+
+
+def frame_method(function):
+    """(class, method) of a backtrace function name, or None.
+
+    Template arguments and a trailing parameter list are dropped, so
+    'std::list<CheckOther::X>::begin' is ('list', 'begin').
+    """
+    name = function
+    while True:
+        stripped = _TEMPLATE_ARGS.sub('', name)
+        if stripped == name:
+            break
+        name = stripped
+    m = _METHOD.search(name.split('(')[0].strip())
+    return (m.group(1), m.group(2)) if m else None
+
+
+def hung_in(frames):
+    """(check class, 'Class::method') of the innermost check frame, or None."""
+    for f in frames:
+        method = frame_method(f.function)
+        if not method:
+            continue
+        cls = method[0]
+        check = cls if cls.startswith('Check') else _FRAME_CHECKS.get(cls)
+        if check:
+            return check, '%s::%s' % method
+    return None
+
+
+def measure(options, path):
+    snapshot = []
+
+    def on_timeout(pid):
+        snapshot.append(hangcorpus.gdb_batch(pid, ['bt']))
+
+    result = hangcorpus.run(options.binary, path, ['--enable=all', '--showtime=summary'] + options.args,
+                            timeout=options.timeout, on_timeout=on_timeout if options.backtrace else None)
+    if result.status == 'timeout':
+        frames = hangcorpus.parse_backtrace(snapshot[0]) if snapshot else []
+        culprit = hung_in(frames)
+        return {'status': 'timeout', 'check': culprit[0] if culprit else None,
+                'hung_in': culprit[1] if culprit else None}
+    timers = hangcorpus.parse_showtime(result.stdout)
+    return {'status': result.status, 'analysis': hangcorpus.total_time(timers),
+            'checks': check_times(timers)}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--binary', required=True, help='cppcheck binary')
+    parser.add_argument('--timeout', type=float, default=120.0, help='seconds per file')
+    parser.add_argument('--backtrace', action='store_true',
+                        help='take a gdb backtrace of timeouts to name the check they hung in')
+    parser.add_argument('--per-file', type=int, default=0, metavar='N',
+                        help='also print the N most expensive checks of every file')
+    parser.add_argument('--top', type=int, default=0, help='rows of the summary (default: all)')
+    parser.add_argument('--json', metavar='FILE', help='write the per-file timers as JSON')
+    parser.add_argument('files', nargs='*', help='inputs (default: the whole corpus)')
+    argv = sys.argv[1:]
+    args = []
+    if '--' in argv:
+        args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    options = parser.parse_args(argv)
+    options.args = args
+
+    report = {}
+    totals = collections.defaultdict(lambda: dict((part, 0.0) for part in PARTS))
+    dominant = collections.Counter()
+    worst = {}
+    hangs = collections.Counter()
+    analysis = 0.0
+    for path in options.files or hangcorpus.corpus_files():
+        name = os.path.basename(path)
+        data = report[name] = measure(options, path)
+        if data['status'] == 'timeout':
+            culprit = data['hung_in']
+            hangs[data['check']] += 1
+            if culprit and not culprit.startswith(data['check'] + '::'):
+                culprit += ' (%s)' % data['check']
+            print('%-12s timeout%s' % (name, ' in ' + culprit if culprit else ''))
+            sys.stdout.flush()
+            continue
+        analysis += data['analysis']
+        costs = dict((check, sum(parts.values())) for check, parts in data['checks'].items())
+        for check, parts in data['checks'].items():
+            for part, seconds in parts.items():
+                totals[check][part] += seconds
+            if check not in worst or costs[check] > worst[check][0]:
+                worst[check] = (costs[check], name)
+        if costs:
+            dominant[max(costs, key=costs.get)] += 1
+        if options.per_file:
+            for check in sorted(costs, key=costs.get, reverse=True)[:options.per_file]:
+                print('%-12s %-28s %9.3fs' % (name, check, costs[check]))
+            sys.stdout.flush()
+
+    checks_total = sum(sum(parts.values()) for parts in totals.values())
+    ranked = sorted(totals, key=lambda c: -sum(totals[c].values()))
+    if options.top:
+        ranked = ranked[:options.top]
+    if options.per_file:
+        print()
+    print('%-28s %11s %11s %10s %7s %7s %5s %6s  %s' % (
+        'check', 'runChecks', 'simplified', 'total', 'checks', 'all', 'top', 'hangs', 'worst file'))
+    for check in ranked:
+        seconds = sum(totals[check].values())
+        print('%-28s %10.3fs %10.3fs %9.3fs %6.1f%% %6.1f%% %5d %6d  %s (%.3fs)' % (
+            check, totals[check]['runChecks'], totals[check]['runSimplifiedChecks'], seconds,
+            100 * seconds / checks_total if checks_total else 0.0,
+            100 * seconds / analysis if analysis else 0.0,
+            dominant[check], hangs.pop(check, 0), worst[check][1], worst[check][0]))
+    for check, count in sorted(hangs.items(), key=lambda i: -i[1]):
+        print('%-28s %11s %11s %10s %7s %7s %5s %6d' % (
+            check or '(no check frame)', '-', '-', '-', '-', '-', '-', count))
+    print('%d files, %.3fs in checks of %.3fs analysed' % (len(report), checks_total, analysis))
+    if options.json:
+        with open(options.json, 'w') as f:
+            json.dump(report, f, indent=1, sort_keys=True)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
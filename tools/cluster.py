@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""Cluster near-duplicate corpus files with MinHash / LSH.
+
+Many files are mutants of one seed (hang44/hang90, hang45/hang57,
+hang52/hang53, hang85/hang88, hang86/hang87, ...). Each file becomes the
+set of k-token shingles of its normalized token stream
+(hangcorpus.normalize), summarised by a MinHash signature. Locality
+sensitive hashing over signature bands proposes candidate pairs, which
+are kept when their estimated Jaccard similarity reaches --threshold.
+Clusters are the connected components; the smallest file of a cluster is
+its representative.
+
+Cost is linear in the number of files plus the number of colliding
+pairs, so the same tool works for fuzzing queues with millions of
+entries.
+
+    tools/cluster.py                        # clusters of the corpus
+    tools/cluster.py --representatives      # one file per cluster
+    tools/cluster.py --threshold 0.7 --json clusters.json queue/*
+"""
+
+import argparse
+import collections
+import hashlib
+import json
+import os
+import random
+import struct
+import sys
+
+import hangcorpus
+
+_PRIME = (1 << 61) - 1
+_MASK = (1 << 64) - 1
+
+
+def shingles(path, k):
+    tokens = hangcorpus.normalize(hangcorpus.tokenize(hangcorpus.read_source(path)))
+    if len(tokens) <= k:
+        grams = [tuple(tokens)]
+    else:
+        grams = [tuple(tokens[i:i + k]) for i in range(len(tokens) - k + 1)]
+    return set(struct.unpack('<Q', hashlib.blake2b('\x1f'.join(g).encode('latin-1'),
+                                                   digest_size=8).digest())[0]
+               for g in grams)
+
+
+class MinHash(object):
+    def __init__(self, permutations, seed=1):
+        rng = random.Random(seed)
+        self.params = [(rng.randrange(1, _PRIME), rng.randrange(0, _PRIME))
+                       for _ in range(permutations)]
+
+    def signature(self, values):
+        if not values:
+            return (_MASK,) * len(self.params)
+        return tuple(min((a * v + b) % _PRIME for v in values) for a, b in self.params)
+
+
+def bands_for(threshold, permutations):
+    """Pick bands * rows = permutations whose S-curve midpoint
+    (1/bands)**(1/rows) is closest to threshold."""
+    best = None
+    for rows in range(1, permutations + 1):
+        if permutations % rows:
+            continue
+        bands = permutations // rows
+        error = abs((1.0 / bands) ** (1.0 / rows) - threshold)
+        if best is None or error < best[0]:
+            best = (error, bands, rows)
+    return best[1], best[2]
+
+
+def similarity(a, b):
+    return sum(1 for x, y in zip(a, b) if x == y) / float(len(a))
+
+
+def cluster(paths, k=3, permutations=128, threshold=0.5):
+    """Return a list of clusters, each a list of paths, smallest file first."""
+    minhash = MinHash(permutations)
+    signatures = [minhash.signature(shingles(p, k)) for p in paths]
+    bands, rows = bands_for(threshold, permutations)
+
+    parent = list(range(len(paths)))
+
+    def find(i):
+        while parent[i] != i:
+            parent[i] = parent[parent[i]]
+            i = parent[i]
+        return i
+
+    for band in range(bands):
+        buckets = collections.defaultdict(list)
+        for i, sig in enumerate(signatures):
+            buckets[sig[band * rows:(band + 1) * rows]].append(i)
+        for members in buckets.values():
+            first = members[0]
+            for other in members[1:]:
+                if find(first) != find(other) and \
+                        similarity(signatures[first], signatures[other]) >= threshold:
+                    parent[find(other)] = find(first)
+
+    groups = collections.defaultdict(list)
+    for i, path in enumerate(paths):
+        groups[find(i)].append(path)
+    clusters = [sorted(g, key=lambda p: (os.path.getsize(p), p)) for g in groups.values()]
+    clusters.sort(key=lambda c: (-len(c), c[0]))
+    return clusters
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--shingle', type=int, default=3, help='tokens per shingle')
+    parser.add_argument('--permutations', type=int, default=128, help='MinHash size')
+    parser.add_argument('--threshold', type=float, default=0.5,
+                        help='estimated Jaccard similarity to merge (default %(default)s)')
+    parser.add_argument('--representatives', action='store_true',
+                        help='print only one file per cluster')
+    parser.add_argument('--json', metavar='FILE', help='write clusters as JSON')
+    parser.add_argument('files', nargs='*', help='inputs (default: the whole corpus)')
+    options = parser.parse_args()
+
+    paths = options.files or hangcorpus.corpus_files()
+    clusters = cluster(paths, options.shingle, options.permutations, options.threshold)
+    if options.json:
+        with open(options.json, 'w') as f:
+            json.dump([{'representative': os.path.basename(c[0]),
+                        'members': [os.path.basename(p) for p in c]} for c in clusters], f, indent=1)
+    for c in clusters:
+        if options.representatives:
+            print(c[0])
+        elif len(c) > 1:
+            print('%s: %s' % (os.path.basename(c[0]), ' '.join(os.path.basename(p) for p in c[1:])))
+    if not options.representatives:
+        print('%d files in %d clusters' % (len(paths), len(clusters)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Minimise the corpus to the smallest subset with the same coverage.
+
+Many files exercise the same code, e.g. the diamond inheritance family
+hang35/55/69/76/84 or the try/catch soups hang23/24/25/54/81/83. This
+tool runs every file once on a coverage build, then keeps, for every
+edge and every hang signature seen, the smallest file that has it, and
+finally drops kept files whose features are all covered by other kept
+files. The result has the same edge coverage and the same set of hang
+signatures as the full corpus and is meant as the fast pre-merge tier.
+
+The binary has to be built with
+
+    clang++ -fsanitize=address -fsanitize-coverage=trace-pc-guard
+
+Hang signatures of files that time out come from a gdb backtrace taken
+before the kill (see hangcorpus.hang_signature); files that finish keep
+the signature of the backtrace recorded with them, if any.
+
+    tools/cmin.py --binary ./cppcheck-cov -j8 --timeout 30 > fast.txt
+    tools/cmin.py --binary ./cppcheck-cov --coverage coverage.json
+    tools/cmin.py --from-coverage coverage.json
+
+--coverage keeps the per-file edges and signatures so that later
+minimisations (and tools/changeselect.py) do not need to re-run anything.
+"""
+
+import argparse
+import collections
+import concurrent.futures
+import json
+import os
+import sys
+
+import hangcorpus
+
+
+def collect(options, paths, extra_args):
+    """Return {name: {'size', 'status', 'signature', 'edges'}} for paths."""
+    def one(path):
+        result, edges, signature = hangcorpus.run_with_coverage(
+            options.binary, path, extra_args, timeout=options.timeout)
+        if not signature:
+            signature = hangcorpus.hang_signature(
+                hangcorpus.parse_backtrace(hangcorpus.embedded_backtrace(path)))
+        return os.path.basename(path), {
+            'size': os.path.getsize(path),
+            'status': result.status,
+            'signature': signature,
+            'edges': sorted('%s+0x%x' % edge for edge in edges),
+        }
+
+    coverage = {}
+    with concurrent.futures.ThreadPoolExecutor(options.jobs) as pool:
+        for name, info in pool.map(one, paths):
+            coverage[name] = info
+            sys.stderr.write('%-12s %-8s %6d edges  %s\n' % (
+                name, info['status'], len(info['edges']), info['signature']))
+    return coverage
+
+
+def features(info):
+    found = set(info['edges'])
+    if info['signature']:
+        found.add('sig:' + info['signature'])
+    return found
+
+
+def minimise(coverage):
+    """Return the names of a minimal subset with the union of all features."""
+    by_size = sorted(coverage, key=lambda name: (coverage[name]['size'], name))
+    owner = {}
+    for name in by_size:
+        for feature in features(coverage[name]):
+            owner.setdefault(feature, name)
+    kept = set(owner.values())
+
+    # The smallest-file-per-feature pass over-selects; drop kept files,
+    # largest first, whose every feature is also held by another kept file.
+    holders = collections.Counter()
+    for name in kept:
+        holders.update(features(coverage[name]))
+    for name in sorted(kept, key=lambda n: (-coverage[n]['size'], n)):
+        mine = features(coverage[name])
+        if all(holders[f] > 1 for f in mine):
+            kept.remove(name)
+            holders.subtract(mine)
+    return [name for name in by_size if name in kept]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--binary', help='cppcheck built with SanitizerCoverage')
+    parser.add_argument('--timeout', type=float, default=60.0, help='seconds per run')
+    parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(), help='parallel runs')
+    parser.add_argument('--coverage', metavar='JSON', help='also write per-file coverage here')
+    parser.add_argument('--from-coverage', metavar='JSON',
+                        help='minimise a previously written coverage file instead of running')
+    parser.add_argument('files', nargs='*', help='inputs (default: the whole corpus)')
+    argv = sys.argv[1:]
+    extra_args = []
+    if '--' in argv:
+        extra_args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    options = parser.parse_args(argv)
+
+    if options.from_coverage:
+        with open(options.from_coverage) as f:
+            coverage = json.load(f)
+    elif options.binary:
+        coverage = collect(options, options.files or hangcorpus.corpus_files(), extra_args)
+    else:
+        parser.error('need --binary or --from-coverage')
+    if options.coverage:
+        with open(options.coverage, 'w') as f:
+            json.dump(coverage, f, indent=0, sort_keys=True)
+    if not any(info['edges'] for info in coverage.values()):
+        sys.stderr.write('warning: no edge coverage recorded; is the binary built with '
+                         '-fsanitize-coverage=trace-pc-guard?\n')
+
+    kept = minimise(coverage)
+    all_features = set().union(*(features(info) for info in coverage.values()))
+    signatures = set(info['signature'] for info in coverage.values() if info['signature'])
+    for name in kept:
+        print(name)
+    sys.stderr.write('kept %d of %d files (%d bytes of %d), %d features, %d hang signatures\n' % (
+        len(kept), len(coverage), sum(coverage[n]['size'] for n in kept),
+        sum(info['size'] for info in coverage.values()), len(all_features), len(signatures)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+"""Seekable compressed corpus archives (.hcpk).
+
+Millions of tiny files cost inodes and directory scans on every run. A
+pack stores them as zlib compressed blocks of about --block-size bytes
+followed by a binary index, so any member is read by decompressing one
+block. The index is laid out for mmap: fixed-size entry records sorted
+by name (binary search without loading the table) and a block table.
+
+  header   'HCPK' u16 version u16 0
+  blocks   zlib streams
+  names    concatenated member names (utf-8)
+  entries  count x <Q name offset, H name length, I block, I offset, I length>
+  blocks   count x <Q file offset, I compressed length, I raw length>
+  footer   <Q names offset, Q entries offset, Q blocks offset, I entries,
+            I blocks> 'HCPK'
+
+Member names are the paths relative to the inputs' common directory
+(--root), so the corpus packs as hang60.cpp and so on, while
+'find queue -type f' over several fuzzer directories keeps
+fuzzer01/queue/id:000001 apart from fuzzer02/queue/id:000001. Names
+are never absolute and never contain '..'.
+
+The flat hang files stay the human-facing corpus; packs are for bulk
+runs (tools/runcorpus.py --pack):
+
+    tools/corpuspack.py create corpus.hcpk                  # the whole corpus
+    find queue -type f | tools/corpuspack.py create queue.hcpk --files-from -
+    tools/corpuspack.py list corpus.hcpk
+    tools/corpuspack.py cat corpus.hcpk hang60.cpp
+    tools/corpuspack.py extract corpus.hcpk --dest /tmp/corpus
+"""
+
+import argparse
+import bisect
+import mmap
+import os
+import struct
+import sys
+import zlib
+
+import hangcorpus
+
+MAGIC = b'HCPK'
+VERSION = 1
+_HEADER = struct.Struct('<4sHH')
+_ENTRY = struct.Struct('<QHIII')
+_BLOCK = struct.Struct('<QII')
+_FOOTER = struct.Struct('<QQQII4s')
+
+
+def check_name(name):
+    """Raise ValueError unless name is a relative path inside the pack."""
+    parts = name.split('/')
+    if not name or name.startswith('/') or '..' in parts or '' in parts or '\\' in name:
+        raise ValueError('bad member name %r' % name)
+    return name
+
+
+def member_names(paths, root=None):
+    """Member names of paths: relative to root, default their common directory."""
+    if root is None:
+        root = os.path.commonpath([os.path.dirname(os.path.abspath(p)) for p in paths])
+    names = [os.path.relpath(os.path.abspath(p), root).replace(os.sep, '/') for p in paths]
+    for name in names:
+        check_name(name)
+    return names
+
+
+def create(path, members, block_size=64 * 1024, level=9):
+    """Write a pack from an iterable of (name, data); names must be unique."""
+    entries = []
+    blocks = []
+    with open(path + '.tmp', 'wb') as out:
+        out.write(_HEADER.pack(MAGIC, VERSION, 0))
+        pending = []
+        pending_size = 0
+
+        def flush():
+            raw = b''.join(pending)
+            packed = zlib.compress(raw, level)
+            blocks.append((out.tell(), len(packed), len(raw)))
+            out.write(packed)
+            del pending[:]
+
+        seen = set()
+        for name, data in members:
+            check_name(name)
+            if name in seen:
+                raise ValueError('duplicate member name %r' % name)
+            seen.add(name)
+            if pending and pending_size + len(data) > block_size:
+                flush()
+                pending_size = 0
+            entries.append((name, len(blocks), pending_size, len(data)))
+            pending.append(data)
+            pending_size += len(data)
+        if pending:
+            flush()
+
+        entries.sort()
+        names_offset = out.tell()
+        name_offsets = []
+        for name, _, _, _ in entries:
+            encoded = name.encode('utf-8')
+            name_offsets.append((out.tell() - names_offset, len(encoded)))
+            out.write(encoded)
+        entries_offset = out.tell()
+        for (name_off, name_len), (_, block, offset, length) in zip(name_offsets, entries):
+            out.write(_ENTRY.pack(name_off, name_len, block, offset, length))
+        blocks_offset = out.tell()
+        for block in blocks:
+            out.write(_BLOCK.pack(*block))
+        out.write(_FOOTER.pack(names_offset, entries_offset, blocks_offset,
+                               len(entries), len(blocks), MAGIC))
+    os.replace(path + '.tmp', path)
+    return len(entries), len(blocks)
+
+
+class Pack(object):
+    """Read-only, mmap backed access to a pack."""
+
+    def __init__(self, path):
+        self._file = open(path, 'rb')
+        self._map = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, _ = _HEADER.unpack_from(self._map, 0)
+        (self._names, self._entries, self._blocks, self.count, self.block_count,
+         tail) = _FOOTER.unpack_from(self._map, len(self._map) - _FOOTER.size)
+        if magic != MAGIC or tail != MAGIC or version != VERSION:
+            raise ValueError('%s: not a version %d corpus pack' % (path, VERSION))
+        self._cached = (None, None)
+
+    def close(self):
+        self._map.close()
+        self._file.close()
+
+    def __len__(self):
+        return self.count
+
+    def _entry(self, i):
+        return _ENTRY.unpack_from(self._map, self._entries + i * _ENTRY.size)
+
+    def name(self, i):
+        name_off, name_len, _, _, _ = self._entry(i)
+        start = self._names + name_off
+        return self._map[start:start + name_len].decode('utf-8')
+
+    def size(self, i):
+        return self._entry(i)[4]
+
+    def find(self, name):
+        """Index of name, or -1; binary search over the mmapped entries."""
+        class Names(object):
+            def __len__(inner):
+                return self.count
+
+            def __getitem__(inner, i):
+                return self.name(i)
+        i = bisect.bisect_left(Names(), name)
+        return i if i < self.count and self.name(i) == name else -1
+
+    def read(self, i):
+        _, _, block, offset, length = self._entry(i)
+        if self._cached[0] != block:
+            file_offset, packed, _ = _BLOCK.unpack_from(self._map, self._blocks + block * _BLOCK.size)
+            self._cached = (block, zlib.decompress(self._map[file_offset:file_offset + packed]))
+        return self._cached[1][offset:offset + length]
+
+    def read_name(self, name):
+        i = self.find(name)
+        if i < 0:
+            raise KeyError(name)
+        return self.read(i)
+
+    def names(self):
+        return [self.name(i) for i in range(self.count)]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    sub = parser.add_subparsers(dest='command', required=True)
+    p = sub.add_parser('create', help='pack files')
+    p.add_argument('pack')
+    p.add_argument('--files-from', metavar='FILE', help="read paths from FILE, '-' for stdin")
+    p.add_argument('--block-size', type=int, default=64 * 1024)
+    p.add_argument('--root', help='directory member names are relative to '
+                                  '(default: the common directory of the inputs)')
+    p.add_argument('files', nargs='*', help='files to pack (default: the whole corpus)')
+    p = sub.add_parser('list', help='list members with their sizes')
+    p.add_argument('pack')
+    p = sub.add_parser('cat', help='write one member to stdout')
+    p.add_argument('pack')
+    p.add_argument('name')
+    p = sub.add_parser('extract', help='unpack all or the named members')
+    p.add_argument('pack')
+    p.add_argument('--dest', default='.')
+    p.add_argument('names', nargs='*')
+    options = parser.parse_args()
+
+    if options.command == 'create':
+        paths = options.files
+        if options.files_from:
+            stream = sys.stdin if options.files_from == '-' else open(options.files_from)
+            paths = [line.rstrip('\n') for line in stream if line.strip()]
+        paths = paths or hangcorpus.corpus_files()
+        try:
+            names = member_names(paths, options.root)
+        except ValueError as e:
+            parser.error('%s; pass a --root that contains every input' % e)
+
+        def members():
+            for name, path in zip(names, paths):
+                with open(path, 'rb') as f:
+                    yield name, f.read()
+        try:
+            count, blocks = create(options.pack, members(), options.block_size)
+        except ValueError as e:
+            os.remove(options.pack + '.tmp')
+            parser.error(str(e))
+        print('%d members in %d blocks, %d bytes' % (count, blocks, os.path.getsize(options.pack)))
+        return 0
+
+    pack = Pack(options.pack)
+    if options.command == 'list':
+        for i in range(len(pack)):
+            print('%8d  %s' % (pack.size(i), pack.name(i)))
+    elif options.command == 'cat':
+        sys.stdout.buffer.write(pack.read_name(options.name))
+    else:
+        os.makedirs(options.dest, exist_ok=True)
+        indices = [pack.find(n) for n in options.names] if options.names else range(len(pack))
+        for i in indices:
+            if i < 0:
+                continue
+            target = os.path.join(options.dest, check_name(pack.name(i)))
+            os.makedirs(os.path.dirname(target), exist_ok=True)
+            with open(target, 'wb') as f:
+                f.write(pack.read(i))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
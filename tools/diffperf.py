@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""Differential performance runner for two cppcheck builds.
+
+Every input is analysed by --old and --new at the same time, so both
+see the same machine load. An input whose CPU time ratio new/old reaches
+--ratio is re-run --repeats more times on both builds; it is reported
+only if the ratio of the medians still reaches --ratio. Timeouts count
+as --timeout seconds, so a new hang shows up as a large ratio.
+
+Inputs are the corpus files (default), the given files, or --generate N
+mutants of the corpus. With --save, confirmed inputs that are not yet
+part of the corpus are written as the next hangNN file together with a
+hangNN_timing.txt note holding both timings:
+
+    tools/diffperf.py --old ./cppcheck-1.80 --new ./cppcheck --ratio 5
+    tools/diffperf.py --old a/cppcheck --new b/cppcheck --generate 500 --save
+"""
+
+import argparse
+import os
+import random
+import statistics
+import sys
+import tempfile
+import threading
+
+import hangcorpus
+from mutator import Mutator
+
+# Below this many CPU seconds on both sides a ratio is mostly noise.
+MIN_SECONDS = 0.05
+
+
+def cost(result, timeout):
+    if result.status == 'timeout':
+        return timeout
+    return result.cpu
+
+
+def run_pair(options, path):
+    """Run old and new on path concurrently and return their costs."""
+    results = {}
+
+    def worker(name, binary):
+        results[name] = hangcorpus.run(binary, path, options.args, timeout=options.timeout)
+
+    threads = [threading.Thread(target=worker, args=('old', options.old)),
+               threading.Thread(target=worker, args=('new', options.new))]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    return cost(results['old'], options.timeout), cost(results['new'], options.timeout), results
+
+
+def ratio(old, new):
+    if max(old, new) < MIN_SECONDS:
+        return 1.0
+    return new / max(old, 0.001)
+
+
+def confirm(options, path):
+    olds = []
+    news = []
+    for _ in range(options.repeats):
+        old, new, _ = run_pair(options, path)
+        olds.append(old)
+        news.append(new)
+    return olds, news
+
+
+def save(path, data, olds, news, options):
+    ext = os.path.splitext(path)[1]
+    target = hangcorpus.next_corpus_name(ext=ext)
+    with open(target, 'wb') as f:
+        f.write(data)
+    note = os.path.splitext(target)[0] + '_timing.txt'
+    with open(note, 'w') as f:
+        f.write('old: %s\n' % options.old)
+        f.write('new: %s\n' % options.new)
+        f.write('args: %s\n' % ' '.join(options.args))
+        f.write('old seconds: %s\n' % ' '.join('%.3f' % t for t in olds))
+        f.write('new seconds: %s\n' % ' '.join('%.3f' % t for t in news))
+        f.write('median ratio: %.2f\n' % ratio(statistics.median(olds), statistics.median(news)))
+    return target
+
+
+def inputs(options, tmp):
+    """Yield (label, path, data) for every input to compare."""
+    if not options.generate:
+        for path in options.files or hangcorpus.corpus_files():
+            with open(path, 'rb') as f:
+                yield os.path.basename(path), path, f.read()
+        return
+    seeds = options.files or hangcorpus.corpus_files()
+    rng = random.Random(options.seed)
+    mutator = Mutator.from_files(seeds, rng)
+    if options.dict:
+        mutator.load_dictionary(options.dict)
+    for n in range(options.generate):
+        parent = rng.choice(seeds)
+        ext = os.path.splitext(parent)[1]
+        tokens = [t.str for t in hangcorpus.tokenize(hangcorpus.read_source(parent))]
+        data = hangcorpus.join_tokens(mutator.mutate(tokens)).encode('latin-1')
+        path = os.path.join(tmp, 'input%d%s' % (n, ext))
+        with open(path, 'wb') as f:
+            f.write(data)
+        yield '%s~%d' % (os.path.basename(parent), n), path, data
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--old', required=True, help='baseline cppcheck binary')
+    parser.add_argument('--new', required=True, help='candidate cppcheck binary')
+    parser.add_argument('--ratio', type=float, default=3.0,
+                        help='flag inputs at least this many times slower (default %(default)s)')
+    parser.add_argument('--repeats', type=int, default=5, help='confirmation runs per side')
+    parser.add_argument('--timeout', type=float, default=60.0, help='seconds per run')
+    parser.add_argument('--generate', type=int, default=0, metavar='N',
+                        help='compare N mutants of the inputs instead of the inputs')
+    parser.add_argument('--seed', type=int, help='random seed for --generate')
+    parser.add_argument('--dict', help='weighted dictionary from tools/mkdict.py (.json)')
+    parser.add_argument('--save', action='store_true',
+                        help='add confirmed generated inputs to the corpus')
+    parser.add_argument('files', nargs='*', help='inputs or seeds (default: the whole corpus)')
+    argv = sys.argv[1:]
+    args = []
+    if '--' in argv:
+        args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    options = parser.parse_args(argv)
+    options.args = args
+
+    flagged = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        for label, path, data in inputs(options, tmp):
+            old, new, _ = run_pair(options, path)
+            if ratio(old, new) < options.ratio:
+                continue
+            olds, news = confirm(options, path)
+            confirmed = ratio(statistics.median(olds), statistics.median(news))
+            if confirmed < options.ratio:
+                print('%-24s noise    first %.2fx, median %.2fx' % (label, ratio(old, new), confirmed))
+                continue
+            flagged += 1
+            where = ''
+            if options.save and path.startswith(tmp):
+                where = '  -> ' + os.path.basename(save(path, data, olds, news, options))
+            print('%-24s SLOWER   %.2fx  old %.3fs  new %.3fs%s' % (
+                label, confirmed, statistics.median(olds), statistics.median(news), where))
+    print('%d input(s) at least %.1fx slower' % (flagged, options.ratio))
+    return 1 if flagged else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
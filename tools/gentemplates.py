@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""Generate template instantiation towers and sweep their analysis cost.
+
+hang14, hang63 (integral_constant / is_lvalue_reference), hang66
+(template template parameters, X<T::template B>), hang78 (allocator
+rebind) and hang22 / hang73 (variadic packs) all hit TemplateSimplifier.
+This generator emits well-formed programs built from the same
+constructs with the size under control:
+
+  depth     levels L1..Ldepth, each instantiating the level below
+  fanout    distinct instantiations of the level below per level, so
+            the program needs fanout**depth instantiations in total
+  pack      length of a variadic tuple<...> carried by every level
+  ttp       reach the level below through a template template parameter
+  rebind    carry an allocator that is rebound at every level
+
+Print one program:
+
+    tools/gentemplates.py --depth 6 --fanout 2 --pack 3 --ttp > t.cpp
+
+Sweep a grid and write CSV suitable for charting the cost curve:
+
+    tools/gentemplates.py --binary ./cppcheck --sweep depth=1..10 fanout=1,2,3
+"""
+
+import argparse
+import csv
+import itertools
+import os
+import sys
+import tempfile
+
+import hangcorpus
+
+PARAMETERS = ('depth', 'fanout', 'pack', 'ttp', 'rebind')
+
+
+def generate(depth=4, fanout=2, pack=0, ttp=False, rebind=False):
+    """Return the source text of one template tower."""
+    out = []
+    emit = out.append
+    emit('template < class T , T v > struct integral_constant {')
+    emit('  static const T value = v ;')
+    emit('  typedef integral_constant < T , v > type ;')
+    emit('} ;')
+    emit('template < class T > struct is_lvalue_reference : integral_constant < bool , false > { } ;')
+    emit('template < class T > struct is_lvalue_reference < T & > : integral_constant < bool , true > { } ;')
+    emit('template < class T , int I > struct W { typedef T type ; } ;')
+    if pack:
+        emit('template < typename ... Args > struct tuple_base { } ;')
+        emit('template < typename ... Args > struct tuple : public tuple_base < Args ... > { } ;')
+    if ttp:
+        emit('template < template < class > class TT , class T > struct apply {')
+        emit('  typedef TT < T > type ;')
+        emit('} ;')
+    if rebind:
+        emit('template < typename Tp > class new_allocator {')
+        emit('public :')
+        emit('  typedef Tp * pointer ;')
+        emit('  template < typename Tp1 > struct rebind { typedef new_allocator < Tp1 > other ; } ;')
+        emit('} ;')
+
+    emit('template < class T > struct L0 : integral_constant < int , 1 > {')
+    emit('  typedef T type ;')
+    emit('} ;')
+    for level in range(1, depth + 1):
+        below = 'L%d' % (level - 1)
+        emit('template < class T > struct L%d {' % level)
+        children = []
+        for i in range(fanout):
+            arg = 'W < T , %d >' % i
+            if ttp:
+                child = 'typename apply < %s , %s > :: type' % (below, arg)
+            else:
+                child = '%s < %s >' % (below, arg)
+            emit('  typedef %s child%d ;' % (child, i))
+            children.append('child%d :: value' % i)
+        emit('  static const int value = %s ;' % ' + '.join(children))
+        emit('  typedef typename child0 :: type type ;')
+        emit('  static const bool is_ref = is_lvalue_reference < T & > :: value ;')
+        if pack:
+            args = ' , '.join(['T'] + ['W < T , %d >' % i for i in range(pack - 1)])
+            emit('  typedef tuple < %s > pack_type ;' % args)
+        if rebind:
+            emit('  typedef typename new_allocator < T > :: template rebind < child0 > :: other alloc ;')
+            emit('  typedef typename alloc :: pointer pointer ;')
+        emit('} ;')
+    emit('int main ( ) {')
+    emit('  return L%d < int > :: value ;' % depth)
+    emit('}')
+    return '\n'.join(out) + '\n'
+
+
+def instantiations(depth, fanout):
+    return sum(fanout ** level for level in range(depth + 1))
+
+
+def parse_values(text):
+    """'1..8' -> 1,2,...,8; '1,2,4' -> 1,2,4; 'yes'/'no' -> booleans."""
+    values = []
+    for part in text.split(','):
+        if '..' in part:
+            low, high = part.split('..')
+            values.extend(range(int(low), int(high) + 1))
+        elif part in ('yes', 'true', 'on'):
+            values.append(True)
+        elif part in ('no', 'false', 'off'):
+            values.append(False)
+        else:
+            values.append(int(part))
+    return values
+
+
+def sweep(options, grid, extra_args):
+    names = [name for name, _ in grid]
+    writer = csv.writer(sys.stdout)
+    writer.writerow(names + ['instantiations', 'bytes', 'status', 'wall', 'cpu', 'maxrss_kb'])
+    base = {name: getattr(options, name) for name in PARAMETERS}
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, 'tower.cpp')
+        for values in itertools.product(*[v for _, v in grid]):
+            params = dict(base, **dict(zip(names, values)))
+            source = generate(**params)
+            with open(path, 'w') as f:
+                f.write(source)
+            result = hangcorpus.run(options.binary, path, extra_args, timeout=options.timeout)
+            writer.writerow(list(values) + [
+                instantiations(params['depth'], params['fanout']), len(source),
+                result.status, '%.4f' % result.wall, '%.4f' % result.cpu, result.maxrss_kb])
+            sys.stdout.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--depth', type=int, default=4)
+    parser.add_argument('--fanout', type=int, default=2)
+    parser.add_argument('--pack', type=int, default=0, help='variadic pack length (0: none)')
+    parser.add_argument('--ttp', action='store_true', help='use template template parameters')
+    parser.add_argument('--rebind', action='store_true', help='rebind an allocator per level')
+    parser.add_argument('--binary', help='cppcheck binary, required for --sweep')
+    parser.add_argument('--timeout', type=float, default=60.0, help='seconds per run')
+    parser.add_argument('--sweep', nargs='+', metavar='PARAM=VALUES',
+                        help='grid to sweep, e.g. depth=1..8 fanout=1,2 ttp=no,yes')
+    argv = sys.argv[1:]
+    extra_args = []
+    if '--' in argv:
+        extra_args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    options = parser.parse_args(argv)
+
+    if not options.sweep:
+        sys.stdout.write(generate(options.depth, options.fanout, options.pack,
+                                  options.ttp, options.rebind))
+        return 0
+    if not options.binary:
+        parser.error('--sweep needs --binary')
+    grid = []
+    for item in options.sweep:
+        name, _, values = item.partition('=')
+        if name not in PARAMETERS or not values:
+            parser.error('bad sweep parameter: %s' % item)
+        grid.append((name, parse_values(values)))
+    sweep(options, grid, extra_args)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,776 @@
+"""Shared helpers for the hang corpus tools.
+
+The corpus is the flat set of hang*.c / hang*.cpp files at the repository
+root. This module knows how to enumerate them, how to split them into
+C/C++ tokens without a compiler, and how to run one cppcheck process on
+one input while measuring wall time, CPU time and peak RSS.
+"""
+
+import itertools
+import json
+import os
+import re
+import resource
+import signal
+import struct
+import subprocess
+import tempfile
+import threading
+import time
+
+CORPUS_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+SOURCE_EXTENSIONS = ('.c', '.cpp')
+
+_CORPUS_NAME = re.compile(r'^hang(\d*)(\.c|\.cpp)$')
+
+
+def corpus_files(root=CORPUS_DIR):
+    """Return the corpus inputs below root, ordered hang.cpp, hang1, hang2, ..."""
+    found = []
+    for name in os.listdir(root):
+        m = _CORPUS_NAME.match(name)
+        if m:
+            number = int(m.group(1)) if m.group(1) else -1
+            found.append((number, m.group(2), os.path.join(root, name)))
+    found.sort()
+    return [path for _, _, path in found]
+
+
+def next_corpus_name(root=CORPUS_DIR, ext='.cpp'):
+    """Return the first free hangNN<ext> path after the highest used number."""
+    highest = 0
+    for name in os.listdir(root):
+        m = _CORPUS_NAME.match(name)
+        if m and m.group(1):
+            highest = max(highest, int(m.group(1)))
+    return os.path.join(root, 'hang%d%s' % (highest + 1, ext))
+
+
+def read_source(path):
+    with open(path, 'rb') as f:
+        return f.read().decode('latin-1')
+
+
+# Longest operators first so that the alternation is greedy.
+_OPERATORS = sorted([
+    '>>=', '<<=', '...', '->*', '::', '->', '++', '--', '<<', '>>', '<=', '>=',
+    '==', '!=', '&&', '||', '+=', '-=', '*=', '/=', '%=', '&=', '|=', '^=',
+    '.*', '##',
+], key=len, reverse=True)
+
+_TOKEN = re.compile(r'''
+    (?P<ws>[ \t\r\f\v]+|\\\n)
+  | (?P<nl>\n)
+  | (?P<comment>//[^\n]*|/\*.*?(?:\*/|\Z))
+  | (?P<string>(?:L|u8|u|U)?"(?:\\.|[^"\\\n])*"?)
+  | (?P<char>(?:L|u8|u|U)?'(?:\\.|[^'\\\n])*'?)
+  | (?P<number>\.?[0-9](?:[eEpP][+-]|[0-9a-zA-Z_.'])*)
+  | (?P<name>[A-Za-z_$][A-Za-z0-9_$]*)
+  | (?P<op>''' + '|'.join(re.escape(op) for op in _OPERATORS) + r'''|[^\s])
+''', re.VERBOSE | re.DOTALL)
+
+
+class Token(object):
+    __slots__ = ('kind', 'str', 'line', 'col')
+
+    def __init__(self, kind, text, line, col):
+        self.kind = kind
+        self.str = text
+        self.line = line
+        self.col = col
+
+    def __repr__(self):
+        return 'Token(%r, %r, %d:%d)' % (self.kind, self.str, self.line, self.col)
+
+
+def tokenize(text, keep_comments=False):
+    """Split C/C++ source into Tokens. Never fails: unknown bytes become ops.
+
+    Preprocessor directives are not interpreted; '#' is an ordinary op.
+    """
+    tokens = []
+    line = 1
+    line_start = 0
+    for m in _TOKEN.finditer(text):
+        kind = m.lastgroup
+        value = m.group()
+        if kind == 'nl':
+            line += 1
+            line_start = m.end()
+            continue
+        if kind == 'ws' or (kind == 'comment' and not keep_comments):
+            pass
+        else:
+            tokens.append(Token(kind, value, line, m.start() - line_start + 1))
+        newlines = value.count('\n')
+        if newlines:
+            line += newlines
+            line_start = m.start() + value.rfind('\n') + 1
+    return tokens
+
+
+KEYWORDS = frozenset('''
+    alignas alignof asm auto bool break case catch char char16_t char32_t class
+    const constexpr const_cast continue decltype default delete do double
+    dynamic_cast else enum explicit export extern false float for friend goto
+    if inline int long mutable namespace new noexcept nullptr operator private
+    protected public register reinterpret_cast restrict return short signed
+    sizeof static static_assert static_cast struct switch template this
+    thread_local throw true try typedef typeid typename union unsigned using
+    virtual void volatile wchar_t while _Bool _Complex __attribute__
+'''.split())
+
+
+def normalize(tokens):
+    """Map Tokens to strings with identifiers and literals abstracted.
+
+    Keywords and punctuation stay; other names become 'I', numbers 'N',
+    string and character literals 'S'. Two mutants of one program that
+    differ only in naming normalize to the same sequence.
+    """
+    out = []
+    for t in tokens:
+        if t.kind == 'name':
+            out.append(t.str if t.str in KEYWORDS else 'I')
+        elif t.kind == 'number':
+            out.append('N')
+        elif t.kind in ('string', 'char'):
+            out.append('S')
+        else:
+            out.append(t.str)
+    return out
+
+
+def join_tokens(strings):
+    """Render a token string sequence back into compilable-looking text."""
+    out = []
+    for s in strings:
+        if s.startswith('#') and s != '##':
+            out.append('\n' + s)
+        elif s == ';' or s == '{' or s == '}':
+            out.append(s + '\n')
+        else:
+            out.append(s)
+    return ' '.join(out).replace('\n ', '\n') + '\n'
+
+
+class Result(object):
+    """Outcome of one analyser run.
+
+    status is 'ok', 'timeout', 'crash' (killed by a signal) or 'error'
+    (nonzero exit). Times are seconds, maxrss_kb is the peak resident set
+    of the analysed process (see run()).
+    """
+
+    __slots__ = ('status', 'returncode', 'wall', 'user', 'sys', 'maxrss_kb',
+                 'stdout', 'stderr', 'cgroup', 'counters')
+
+    def __init__(self, status, returncode, wall, user, sys, maxrss_kb, stdout, stderr,
+                 cgroup=None, counters=None):
+        self.status = status
+        self.returncode = returncode
+        self.wall = wall
+        self.user = user
+        self.sys = sys
+        self.maxrss_kb = maxrss_kb
+        self.stdout = stdout
+        self.stderr = stderr
+        self.cgroup = cgroup
+        self.counters = counters
+
+    @property
+    def cpu(self):
+        return self.user + self.sys
+
+    def as_dict(self):
+        result = {
+            'status': self.status,
+            'returncode': self.returncode,
+            'wall': round(self.wall, 6),
+            'user': round(self.user, 6),
+            'sys': round(self.sys, 6),
+            'maxrss_kb': self.maxrss_kb,
+        }
+        if self.cgroup:
+            result['cgroup'] = self.cgroup
+        if self.counters:
+            result['counters'] = self.counters
+        return result
+
+
+def _limit_child(mem_limit_mb):
+    def apply():
+        if mem_limit_mb:
+            limit = mem_limit_mb * 1024 * 1024
+            resource.setrlimit(resource.RLIMIT_AS, (limit, limit))
+    return apply
+
+
+class CgroupLimits(object):
+    """Limits for the transient cgroup v2 leaf each run gets.
+
+    parent must be a cgroup this user owns and the runner must already
+    run inside it: moving a process between cgroups needs write access
+    to cgroup.procs of their common ancestor, so a child can only enter
+    a leaf below parent if it starts below parent. Either let systemd
+    delegate the runner's own cgroup and pass 'self' as parent:
+
+        systemd-run --user --scope -p Delegate=yes \
+            tools/runcorpus.py --cgroup self --memory-max 2048 ...
+
+    or set one up as root and move the shell the runner starts from in:
+
+        mkdir /sys/fs/cgroup/hangcorpus
+        echo '+memory +cpu +pids' > /sys/fs/cgroup/cgroup.subtree_control
+        chown -R $USER /sys/fs/cgroup/hangcorpus
+        echo $$ > /sys/fs/cgroup/hangcorpus/cgroup.procs
+
+    check() moves the processes in parent (the runner, its shell) into a
+    'runner' leaf before it enables the controllers, since cgroup v2
+    does not allow processes in a cgroup whose controllers are handed
+    down to children.
+
+    memory_mb sets memory.max (and memory.swap.max to 0, so a runaway
+    expansion is OOM killed instead of swapping), cpus sets cpu.max as a
+    number of CPUs and pids sets pids.max.
+    """
+
+    CONTROLLERS = ('memory', 'cpu', 'pids')
+    PERIOD_USEC = 100000
+    _serial = itertools.count()
+
+    def __init__(self, parent, memory_mb=None, cpus=None, pids=None):
+        self.parent = self.own_cgroup() if parent == 'self' else parent
+        self.memory_mb = memory_mb
+        self.cpus = cpus
+        self.pids = pids
+
+    @staticmethod
+    def own_cgroup(root='/sys/fs/cgroup'):
+        """Directory of the cgroup v2 the calling process is in."""
+        with open('/proc/self/cgroup') as f:
+            for line in f:
+                if line.startswith('0::'):
+                    return os.path.join(root, line[3:].strip().lstrip('/'))
+        raise OSError('not in a cgroup v2 hierarchy')
+
+    def check(self):
+        """Enable the controllers below parent; raises OSError if not possible."""
+        with open(os.path.join(self.parent, 'cgroup.controllers')) as f:
+            available = f.read().split()
+        missing = [c for c in self.CONTROLLERS if c not in available]
+        if missing:
+            raise OSError('%s: controllers %s not available' % (self.parent, ' '.join(missing)))
+        with open(os.path.join(self.parent, 'cgroup.subtree_control')) as f:
+            enabled = f.read().split()
+        if not self._contains_runner():
+            raise OSError('%s: the runner is not inside this cgroup, so its runs cannot '
+                          'enter it' % self.parent)
+        with open(os.path.join(self.parent, 'cgroup.procs')) as f:
+            procs = f.read().split()
+        if procs:
+            runner = Cgroup(os.path.join(self.parent, 'runner'))
+            os.makedirs(runner.path, exist_ok=True)
+            for pid in procs:
+                try:
+                    runner.write('cgroup.procs', pid)
+                except ProcessLookupError:
+                    pass
+        wanted = ' '.join('+' + c for c in self.CONTROLLERS if c not in enabled)
+        if wanted:
+            with open(os.path.join(self.parent, 'cgroup.subtree_control'), 'w') as f:
+                f.write(wanted)
+
+    def _contains_runner(self):
+        parent = os.path.realpath(self.parent)
+        root = parent
+        # The mount point is the topmost directory of the hierarchy.
+        while root != '/' and os.path.exists(os.path.join(os.path.dirname(root), 'cgroup.controllers')):
+            root = os.path.dirname(root)
+        try:
+            own = os.path.realpath(self.own_cgroup(root))
+        except OSError:
+            return False
+        return own == parent or own.startswith(parent + os.sep)
+
+    def create(self):
+        path = os.path.join(self.parent, 'run-%d-%d' % (os.getpid(), next(self._serial)))
+        os.mkdir(path)
+        cgroup = Cgroup(path)
+        if self.memory_mb:
+            cgroup.write('memory.max', str(self.memory_mb * 1024 * 1024))
+            cgroup.write('memory.swap.max', '0', optional=True)
+        if self.cpus:
+            cgroup.write('cpu.max', '%d %d' % (self.cpus * self.PERIOD_USEC, self.PERIOD_USEC))
+        if self.pids:
+            cgroup.write('pids.max', str(self.pids))
+        return cgroup
+
+
+class Cgroup(object):
+    """One transient cgroup v2 leaf."""
+
+    def __init__(self, path):
+        self.path = path
+
+    def write(self, name, value, optional=False):
+        try:
+            with open(os.path.join(self.path, name), 'w') as f:
+                f.write(value)
+        except FileNotFoundError:
+            if not optional:
+                raise
+
+    def read(self, name):
+        try:
+            with open(os.path.join(self.path, name)) as f:
+                return f.read()
+        except FileNotFoundError:
+            return None
+
+    def _keyed(self, name):
+        text = self.read(name) or ''
+        return dict((k, int(v)) for k, v in (line.split() for line in text.splitlines() if line))
+
+    def enter(self):
+        """Move the calling process in; used as the child's preexec_fn."""
+        self.write('cgroup.procs', str(os.getpid()))
+
+    def kill(self):
+        """Kill every process in the cgroup (cgroup.kill, Linux 5.14+)."""
+        try:
+            self.write('cgroup.kill', '1')
+            return True
+        except OSError:
+            return False
+
+    def stats(self):
+        """Exact usage of everything that ran in the cgroup."""
+        cpu = self._keyed('cpu.stat')
+        events = self._keyed('memory.events')
+        peak = self.read('memory.peak')
+        return {
+            'cpu_usec': cpu.get('usage_usec'),
+            'user_usec': cpu.get('user_usec'),
+            'system_usec': cpu.get('system_usec'),
+            'throttled_usec': cpu.get('throttled_usec'),
+            'memory_peak_kb': int(peak) // 1024 if peak and peak.strip().isdigit() else None,
+            'oom_kill': events.get('oom_kill', 0),
+            'pids_max_hit': self._keyed('pids.events').get('max', 0),
+        }
+
+    def remove(self):
+        for _ in range(50):
+            try:
+                os.rmdir(self.path)
+                return
+            except FileNotFoundError:
+                return
+            except OSError:
+                # Still busy until the last killed process is reaped.
+                time.sleep(0.01)
+
+
+RSS_INTERVAL = 0.02
+
+
+def _status_kb(pid, field):
+    """A kB field of /proc/<pid>/status, or None (gone, or no such field)."""
+    try:
+        with open('/proc/%s/status' % pid) as f:
+            for line in f:
+                if line.startswith(field + ':'):
+                    return int(line.split()[1])
+    except (OSError, ValueError):
+        pass
+    return None
+
+
+def run(binary, path, args=(), timeout=None, mem_limit_mb=None, env=None, on_timeout=None,
+        cgroup=None):
+    """Analyse path with binary and return a Result.
+
+    The child runs in its own session so that a timeout kills the whole
+    process group. mem_limit_mb caps the address space; an input that hits
+    the cap usually ends as 'crash' (std::bad_alloc -> abort) or 'error'.
+    on_timeout(pid) is called on a timed out process before it is killed,
+    e.g. to take a backtrace with gdb_batch().
+
+    With cgroup (a CgroupLimits) the child runs in a fresh cgroup leaf
+    whose limits replace mem_limit_mb, and Result.cgroup holds the
+    leaf's exact CPU and memory usage.
+
+    wait4()'s ru_maxrss alone is no measure of the child: the copy of
+    this process that fork() makes and exec() replaces counts too, so
+    /bin/true "peaks" at the runner's size. It is used only when it
+    exceeds the runner's own peak, and the analyser must have got there
+    itself. Otherwise maxrss_kb is the largest VmHWM of the child read
+    from /proc every RSS_INTERVAL seconds, short by at most the growth
+    of the last interval (ru_maxrss, an upper bound, for a run gone
+    before the first read).
+    """
+    cmd = [binary] + list(args) + [path]
+    leaf = cgroup.create() if cgroup else None
+    limit = _limit_child(None if leaf else mem_limit_mb)
+
+    def prepare():
+        if leaf:
+            leaf.enter()
+        limit()
+
+    with tempfile.TemporaryFile() as out, tempfile.TemporaryFile() as err:
+        start = time.monotonic()
+        try:
+            proc = subprocess.Popen(cmd, stdin=subprocess.DEVNULL, stdout=out, stderr=err,
+                                    start_new_session=True, env=env, preexec_fn=prepare)
+        except BaseException:
+            if leaf:
+                leaf.remove()
+            raise
+        # Popen returns once the child has exec()ed, so VmHWM is the analyser's.
+        sampled = [None]
+        reaped = threading.Event()
+
+        def sample():
+            hwm = _status_kb(proc.pid, 'VmHWM')
+            if hwm is not None:
+                sampled[0] = max(sampled[0] or 0, hwm)
+
+        def sampler():
+            sample()
+            while not reaped.wait(RSS_INTERVAL):
+                sample()
+
+        watcher = threading.Thread(target=sampler)
+        watcher.start()
+        timed_out = threading.Event()
+
+        def expire():
+            timed_out.set()
+            sample()
+            if on_timeout:
+                on_timeout(proc.pid)
+            if leaf and leaf.kill():
+                return
+            try:
+                os.killpg(proc.pid, signal.SIGKILL)
+            except OSError:
+                pass
+
+        timer = threading.Timer(timeout, expire) if timeout else None
+        if timer:
+            timer.start()
+        try:
+            _, status, usage = os.wait4(proc.pid, 0)
+        finally:
+            reaped.set()
+            if timer:
+                timer.cancel()
+            watcher.join()
+        wall = time.monotonic() - start
+        proc.returncode = os.waitstatus_to_exitcode(status)
+        usage_cgroup = None
+        if leaf:
+            leaf.kill()
+            usage_cgroup = leaf.stats()
+            leaf.remove()
+        out.seek(0)
+        err.seek(0)
+        stdout = out.read().decode('utf-8', 'replace')
+        stderr = err.read().decode('utf-8', 'replace')
+
+    if timed_out.is_set():
+        state = 'timeout'
+    elif proc.returncode < 0:
+        state = 'crash'
+    elif proc.returncode > 0:
+        state = 'error'
+    else:
+        state = 'ok'
+    maxrss = usage.ru_maxrss
+    if sampled[0] is not None and maxrss <= (_status_kb('self', 'VmHWM') or 0):
+        maxrss = sampled[0]
+    return Result(state, proc.returncode, wall, usage.ru_utime, usage.ru_stime,
+                  maxrss, stdout, stderr, usage_cgroup)
+
+
+def gdb_batch(pid, commands, timeout=120):
+    """Attach gdb to a running process, run commands and return the output.
+
+    Needs ptrace permission on pid (kernel.yama.ptrace_scope=0 or
+    CAP_SYS_PTRACE). Returns '' when gdb is missing or fails.
+    """
+    cmd = ['gdb', '-nx', '-batch', '-p', str(pid)]
+    for command in commands:
+        cmd += ['-ex', command]
+    try:
+        return subprocess.run(cmd, stdin=subprocess.DEVNULL, stdout=subprocess.PIPE,
+                              stderr=subprocess.DEVNULL, timeout=timeout).stdout.decode('utf-8', 'replace')
+    except (OSError, subprocess.TimeoutExpired):
+        return ''
+
+
+def child_pids(pid):
+    """Pids of the children of pid, e.g. of the analyser under a wrapper
+    such as tools/perfstat.c; [] once pid is gone."""
+    children = []
+    for entry in os.listdir('/proc'):
+        if not entry.isdigit():
+            continue
+        try:
+            with open('/proc/%s/stat' % entry) as f:
+                stat = f.read()
+        except OSError:
+            continue
+        # The command name may contain spaces and parentheses; ppid follows the state.
+        if int(stat[stat.rindex(')') + 2:].split()[1]) == pid:
+            children.append(int(entry))
+    return sorted(children)
+
+
+_FRAME_START = re.compile(r'^#(\d+)\s+', re.M)
+_FRAME_FUNCTION = re.compile(r'^(?:0x[0-9a-fA-F]+\s+in\s+)?(.+?)\s\(')
+_FRAME_SOURCE = re.compile(r'\sat\s+(\S+):(\d+)\s*$')
+
+
+class Frame(object):
+    __slots__ = ('function', 'source', 'line')
+
+    def __init__(self, function, source, line):
+        self.function = function
+        self.source = source
+        self.line = line
+
+    def __repr__(self):
+        return 'Frame(%r, %r, %r)' % (self.function, self.source, self.line)
+
+
+def parse_backtrace(text):
+    """Return the Frames of the first gdb 'bt' in text, innermost first."""
+    frames = []
+    starts = list(_FRAME_START.finditer(text))
+    for n, m in enumerate(starts):
+        if int(m.group(1)) != len(frames):
+            break
+        end = starts[n + 1].start() if n + 1 < len(starts) else len(text)
+        body = ' '.join(text[m.end():end].split())
+        body = body.split('*/')[0].strip()
+        func = _FRAME_FUNCTION.match(body)
+        source = _FRAME_SOURCE.search(body)
+        frames.append(Frame(func.group(1) if func else '??',
+                            source.group(1) if source else None,
+                            int(source.group(2)) if source else None))
+    return frames
+
+
+def embedded_backtrace(path):
+    """Return the gdb backtrace recorded with a corpus file, or ''.
+
+    Backtraces live in a comment of the file itself (hang16.cpp) or next
+    to it as <name>_bt.txt (hang95.cpp).
+    """
+    sidecar = os.path.splitext(path)[0] + '_bt.txt'
+    if os.path.exists(sidecar):
+        return read_source(sidecar)
+    text = read_source(path)
+    m = _FRAME_START.search(text)
+    return text[m.start():] if m else ''
+
+
+# Token primitives sit on top of almost every hanging stack; the loop
+# that hangs is in their caller.
+_PRIMITIVE_SOURCES = ('lib/token.cpp', 'lib/token.h', 'lib/tokenlist.cpp', 'lib/tokenlist.h')
+
+
+def hang_signature(frames, depth=2):
+    """Name a hang by the innermost analyser frames of its backtrace.
+
+    Frames outside lib/ (libc, libstdc++, cli/) and token primitives are
+    skipped so that two samples of the same endless loop agree, e.g.
+    'TemplateSimplifier::expandTemplate < TemplateSimplifier::simplifyTemplateInstantiations'.
+    """
+    lib = [f for f in frames if f.source and f.source.startswith('lib/')]
+    picked = [f for f in lib if f.source not in _PRIMITIVE_SOURCES] or lib
+    names = []
+    for f in picked:
+        name = re.sub(r'<.*>', '', f.function)
+        if name not in names:
+            names.append(name)
+        if len(names) == depth:
+            break
+    return ' < '.join(names)
+
+
+# Analysis stages in pipeline order, and the lib/ sources and timer or
+# function name prefixes that belong to each of them.
+STAGES = ('preprocess', 'tokenize', 'templates', 'symboldatabase', 'valueflow', 'checks')
+
+STAGE_SOURCES = (
+    ('preprocess', ('lib/preprocessor.', 'externals/simplecpp/', 'lib/simplecpp.')),
+    ('templates', ('lib/templatesimplifier.',)),
+    ('symboldatabase', ('lib/symboldatabase.',)),
+    ('valueflow', ('lib/valueflow.', 'lib/programmemory.')),
+    ('checks', ('lib/check', 'lib/executionpath.')),
+    ('tokenize', ('lib/tokenize.', 'lib/tokenlist.', 'lib/token.')),
+)
+
+_STAGE_NAMES = (
+    ('preprocess', ('Preprocessor', 'simplecpp')),
+    ('templates', ('TemplateSimplifier', '::simplifyTemplates')),
+    ('symboldatabase', ('SymbolDatabase', 'Tokenizer::tokenize::createSymbolDatabase',
+                        'Tokenizer::createSymbolDatabase')),
+    ('valueflow', ('ValueFlow', 'valueFlow', 'Tokenizer::tokenize::ValueFlow')),
+    ('checks', ('Check', '::runChecks', '::runSimplifiedChecks')),
+    ('tokenize', ('Tokenizer', 'TokenList', 'Token::')),
+)
+
+
+def classify_stage(name=None, source=None):
+    """Return the stage of a source file or of a function / timer name."""
+    if source:
+        for stage, prefixes in STAGE_SOURCES:
+            if source.startswith(prefixes):
+                return stage
+        return None
+    if name:
+        for stage, prefixes in _STAGE_NAMES:
+            if any(p in name for p in prefixes):
+                return stage
+    return None
+
+
+def hang_stage(frames):
+    """Return the stage of the innermost frame that belongs to one."""
+    for f in frames:
+        if f.source and f.source not in _PRIMITIVE_SOURCES:
+            stage = classify_stage(source=f.source)
+            if stage:
+                return stage
+    for f in frames:
+        stage = classify_stage(source=f.source)
+        if stage:
+            return stage
+    return None
+
+
+_SHOWTIME = re.compile(r'^(\S.*?): ([0-9.]+)s \(avg\. [0-9.]+s - (\d+) result\(s\)\)\s*$', re.M)
+
+
+def parse_showtime(text):
+    """{timer name: seconds} from cppcheck --showtime=summary output."""
+    return dict((m.group(1), float(m.group(2))) for m in _SHOWTIME.finditer(text))
+
+
+def _enclosing_timer(name, timers):
+    """The closest timer name is nested in: 'A::b::c' runs inside 'A::b'."""
+    parts = name.split('::')
+    for n in range(len(parts) - 1, 1, -1):
+        prefix = '::'.join(parts[:n])
+        if prefix in timers:
+            return prefix
+    return None
+
+
+def self_times(timers):
+    """Parsed --showtime timers less the timers nested in them.
+
+    Tokenizer::tokenize includes Tokenizer::tokenize::simplifyTemplates,
+    ::createSymbolDatabase, ::ValueFlow and so on; without this the
+    nested time would be counted twice.
+    """
+    own = dict(timers)
+    for name, seconds in timers.items():
+        parent = _enclosing_timer(name, timers)
+        if parent:
+            own[parent] -= seconds
+    return dict((name, max(seconds, 0.0)) for name, seconds in own.items())
+
+
+def total_time(timers):
+    """Seconds of all top-level --showtime timers."""
+    return sum(seconds for name, seconds in timers.items() if not _enclosing_timer(name, timers))
+
+
+def stage_times(timers):
+    """Sum parsed --showtime timers per stage; unknown timers go to None.
+
+    Nested timers count for their own stage only, so the stages add up
+    to total_time(timers).
+    """
+    totals = dict((stage, 0.0) for stage in STAGES)
+    for name, seconds in self_times(timers).items():
+        stage = classify_stage(name=name)
+        totals[stage] = totals.get(stage, 0.0) + seconds
+    return totals
+
+
+def read_perfstat(path):
+    """Counters written by tools/perfstat.c, summed per stage.
+
+    Returns {'total': {counter: n}, 'stages': {stage: {counter: n}}} or
+    None when the file is missing (perfstat was killed with the run).
+    Markers are stage names or timer names; the counts before the first
+    marker and under unknown markers go to the stage 'other'.
+    """
+    try:
+        with open(path) as f:
+            data = json.load(f)
+    except (OSError, ValueError):
+        return None
+    stages = {}
+    for segment in data['segments']:
+        marker = segment.pop('marker')
+        stage = marker if marker in STAGES else classify_stage(name=marker) or 'other'
+        totals = stages.setdefault(stage, {})
+        for counter, n in segment.items():
+            totals[counter] = totals.get(counter, 0) + n
+    return {'total': data['totals'], 'stages': stages}
+
+
+_SANCOV_MAGIC = {0xC0BFFFFFFFFFFF64: 'Q', 0xC0BFFFFFFFFFFF32: 'I'}
+
+
+def read_sancov(path):
+    """Return the set of module offsets in a SanitizerCoverage .sancov file."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if len(data) < 8:
+        return set()
+    magic = struct.unpack_from('<Q', data)[0]
+    kind = _SANCOV_MAGIC.get(magic)
+    if kind is None:
+        raise ValueError('%s: not a .sancov file' % path)
+    count = (len(data) - 8) // struct.calcsize(kind)
+    return set(struct.unpack_from('<%d%s' % (count, kind), data, 8))
+
+
+def run_with_coverage(binary, path, args=(), timeout=None, env=None):
+    """Run like run() and also collect edge coverage and a hang signature.
+
+    binary must be built with clang -fsanitize=address
+    -fsanitize-coverage=trace-pc-guard. Coverage is dumped by the
+    sanitizer runtime at exit; a timed out process is told to dump it
+    through gdb before it is killed, which also yields its backtrace.
+    Returns (Result, edges, signature); edges is a set of
+    (module, offset) pairs, empty for binaries without coverage.
+    """
+    with tempfile.TemporaryDirectory() as coverage_dir:
+        env = dict(env if env is not None else os.environ)
+        env['ASAN_OPTIONS'] = ':'.join(filter(None, [
+            env.get('ASAN_OPTIONS', ''), 'coverage=1', 'coverage_dir=' + coverage_dir]))
+        snapshot = []
+
+        def on_timeout(pid):
+            snapshot.append(gdb_batch(pid, ['bt', 'call (void)__sanitizer_cov_dump()']))
+
+        result = run(binary, path, args, timeout=timeout, env=env, on_timeout=on_timeout)
+        edges = set()
+        for name in os.listdir(coverage_dir):
+            if name.endswith('.sancov'):
+                module = name.split('.')[0]
+                edges.update((module, pc) for pc in read_sancov(os.path.join(coverage_dir, name)))
+    signature = ''
+    if snapshot:
+        signature = hang_signature(parse_backtrace(snapshot[0]))
+    return result, edges, signature
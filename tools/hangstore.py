@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+"""Content-addressed store for hanging inputs found by fuzzing.
+
+Campaigns find far more hangs than can be committed as hangNN files.
+The store keeps each distinct input once, keyed by the SHA-256 of its
+normalized token stream (hangcorpus.normalize), so inputs that differ
+only in whitespace, comments, names or literal values collapse:
+
+  objects/ab/cdef...        the first input seen with that key
+  objects/ab/cdef....ext    the extension it arrived with, used on
+                            export (the same tokens as .c and as .cpp
+                            are one object)
+  objects/ab/cdef....sigs   signature hashes the object is indexed under
+  by-signature/<sighash>    first line the hang signature, then
+                            '<size> <object>' per object
+  by-size/<log2 size>       '<size> <object> <sighash>' per object
+  backtraces/<sighash>      first gdb backtrace seen for the signature
+
+Ingesting one input costs one object write and two appended index lines,
+independent of the store size. 'export' copies the smallest input of
+every signature that was not exported before and that no corpus file
+has yet (the manifest's signature, else the file's backtrace) into the
+corpus as the next hangNN file, with its backtrace as hangNN_bt.txt:
+
+    tools/hangstore.py ingest findings/hangs/*            # signature unknown
+    tools/hangstore.py ingest --binary ./cppcheck --timeout 20 findings/hangs/*
+    find queue -type f | tools/hangstore.py ingest --files-from -
+    tools/hangstore.py export
+    tools/hangstore.py stats
+"""
+
+import argparse
+import hashlib
+import math
+import os
+import sys
+
+import hangcorpus
+import manifest
+
+STORE = os.path.join(hangcorpus.CORPUS_DIR, 'hangstore')
+
+UNKNOWN = 'unknown'
+
+
+def content_key(text):
+    normalized = ' '.join(hangcorpus.normalize(hangcorpus.tokenize(text)))
+    return hashlib.sha256(normalized.encode('latin-1')).hexdigest()
+
+
+def signature_key(signature):
+    return hashlib.sha1(signature.encode('utf-8')).hexdigest()[:16]
+
+
+class Store(object):
+    def __init__(self, root=STORE):
+        self.root = root
+        for sub in ('objects', 'by-signature', 'by-size', 'backtraces'):
+            os.makedirs(os.path.join(root, sub), exist_ok=True)
+
+    def _append(self, path, line, header=None):
+        new = header is not None and not os.path.exists(path)
+        with open(path, 'a') as f:
+            if new:
+                f.write(header + '\n')
+            f.write(line + '\n')
+
+    def _write(self, path, data):
+        tmp = path + '.tmp'
+        with open(tmp, 'wb') as f:
+            f.write(data)
+        os.replace(tmp, path)
+
+    def add(self, data, ext, signature=UNKNOWN, backtrace=''):
+        """Store data; returns (key, True) when it was new.
+
+        An input that is already stored is only indexed again when it
+        arrives with a signature it was not indexed under yet.
+        """
+        key = content_key(data.decode('latin-1'))
+        path = self.object_path(key)
+        sighash = signature_key(signature)
+        new = not os.path.exists(path)
+        if new:
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+            # Written first, so that every object has one.
+            self._write(path + '.ext', ext.encode('ascii'))
+            self._write(path, data)
+        elif signature == UNKNOWN or sighash in self.object_signatures(key):
+            return key, False
+        self._append(path + '.sigs', sighash)
+
+        size = len(data)
+        self._append(os.path.join(self.root, 'by-signature', sighash),
+                     '%d %s' % (size, key), header=signature)
+        if new:
+            bucket = int(math.log(size, 2)) if size else 0
+            self._append(os.path.join(self.root, 'by-size', '%02d' % bucket),
+                         '%d %s %s' % (size, key, sighash))
+        trace = os.path.join(self.root, 'backtraces', sighash)
+        if backtrace and not os.path.exists(trace):
+            with open(trace, 'w') as f:
+                f.write(backtrace)
+        return key, new
+
+    def object_path(self, key):
+        return os.path.join(self.root, 'objects', key[:2], key[2:])
+
+    def extension(self, key):
+        try:
+            with open(self.object_path(key) + '.ext') as f:
+                return f.read().strip() or '.cpp'
+        except FileNotFoundError:
+            return '.cpp'
+
+    def object_signatures(self, key):
+        """Signature hashes key is indexed under; none when an interrupted
+        ingest stored the object but not its .sigs."""
+        try:
+            with open(self.object_path(key) + '.sigs') as f:
+                return set(f.read().split())
+        except FileNotFoundError:
+            return set()
+
+    def signatures(self):
+        """Yield (sighash, signature, [(size, object key)])."""
+        directory = os.path.join(self.root, 'by-signature')
+        for sighash in sorted(os.listdir(directory)):
+            with open(os.path.join(directory, sighash)) as f:
+                signature = f.readline().rstrip('\n')
+                objects = [(int(size), name) for size, name in
+                           (line.split() for line in f if line.strip())]
+            yield sighash, signature, objects
+
+
+def classify(options, path, data):
+    """Return (signature, backtrace) for one input."""
+    if options.signature:
+        return options.signature, ''
+    backtrace = hangcorpus.embedded_backtrace(path)
+    if not backtrace and options.binary:
+        snapshot = []
+        hangcorpus.run(options.binary, path, timeout=options.timeout,
+                       on_timeout=lambda pid: snapshot.append(hangcorpus.gdb_batch(pid, ['bt'])))
+        backtrace = snapshot[0] if snapshot else ''
+    signature = hangcorpus.hang_signature(hangcorpus.parse_backtrace(backtrace))
+    return signature or UNKNOWN, backtrace
+
+
+def ingest(options, store):
+    paths = list(options.files)
+    if options.files_from:
+        stream = sys.stdin if options.files_from == '-' else open(options.files_from)
+        paths = (line.rstrip('\n') for line in stream)
+    added = seen = 0
+    for path in paths:
+        if not path:
+            continue
+        with open(path, 'rb') as f:
+            data = f.read()
+        ext = os.path.splitext(path)[1]
+        if ext not in hangcorpus.SOURCE_EXTENSIONS:
+            ext = '.cpp'
+        signature, backtrace = classify(options, path, data)
+        _, new = store.add(data, ext, signature, backtrace)
+        seen += 1
+        added += new
+    print('%d inputs, %d new objects' % (seen, added))
+
+
+def corpus_signatures(root):
+    """Hang signatures the corpus in root already has a file for.
+
+    Taken from the manifest where it has an entry, otherwise from the
+    file's recorded backtrace.
+    """
+    files = manifest.Manifest(os.path.join(root, 'manifest.json')).files
+    signatures = set()
+    for path in hangcorpus.corpus_files(root):
+        entry = files.get(os.path.basename(path))
+        if entry is not None:
+            signature = entry.get('signature')
+        else:
+            signature = hangcorpus.hang_signature(
+                hangcorpus.parse_backtrace(hangcorpus.embedded_backtrace(path)))
+        if signature:
+            signatures.add(signature)
+    return signatures
+
+
+def export(options, store):
+    exported_path = os.path.join(store.root, 'exported')
+    exported = {}
+    if os.path.exists(exported_path):
+        with open(exported_path) as f:
+            exported = dict(line.split() for line in f if line.strip())
+    # Signatures the corpus already has a file for need no export, nor do
+    # inputs that are a corpus file up to normalization.
+    known = corpus_signatures(options.dest)
+    present = set()
+    for path in hangcorpus.corpus_files(options.dest):
+        present.add(content_key(hangcorpus.read_source(path)))
+    count = 0
+    for sighash, signature, objects in store.signatures():
+        if sighash in exported or not objects or signature in known:
+            continue
+        if signature == UNKNOWN and not options.unknown:
+            continue
+        if any(key in present for _, key in objects):
+            continue
+        size, key = min(objects)
+        if options.max_size and size > options.max_size:
+            continue
+        target = hangcorpus.next_corpus_name(options.dest, store.extension(key))
+        with open(store.object_path(key), 'rb') as src, open(target, 'wb') as dst:
+            dst.write(src.read())
+        trace = os.path.join(store.root, 'backtraces', sighash)
+        if os.path.exists(trace):
+            with open(trace) as src, open(os.path.splitext(target)[0] + '_bt.txt', 'w') as dst:
+                dst.write(src.read())
+        with open(exported_path, 'a') as f:
+            f.write('%s %s\n' % (sighash, os.path.basename(target)))
+        print('%-14s %6d bytes  %s' % (os.path.basename(target), size, signature))
+        count += 1
+    if count:
+        print('%d new corpus files; run tools/manifest.py update' % count)
+
+
+def stats(store):
+    total = 0
+    for _, signature, objects in store.signatures():
+        total += len(objects)
+        print('%6d objects, smallest %6d bytes  %s' % (
+            len(objects), min(objects)[0] if objects else 0, signature))
+    print('%d index entries' % total)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--store', default=STORE, help='store directory (default %(default)s)')
+    sub = parser.add_subparsers(dest='command', required=True)
+    p = sub.add_parser('ingest', help='add inputs to the store')
+    p.add_argument('--files-from', metavar='FILE', help="read input paths from FILE, '-' for stdin")
+    p.add_argument('--signature', help='hang signature of all inputs, if known')
+    p.add_argument('--binary', help='cppcheck binary to take a backtrace with')
+    p.add_argument('--timeout', type=float, default=20.0, help='seconds before the backtrace')
+    p.add_argument('files', nargs='*')
+    p = sub.add_parser('export', help='copy the smallest input per signature into the corpus')
+    p.add_argument('--dest', default=hangcorpus.CORPUS_DIR)
+    p.add_argument('--max-size', type=int, help='skip representatives larger than this')
+    p.add_argument('--unknown', action='store_true', help='also export the unknown signature')
+    sub.add_parser('stats', help='objects per signature')
+    options = parser.parse_args()
+
+    store = Store(options.store)
+    if options.command == 'ingest':
+        ingest(options, store)
+    elif options.command == 'export':
+        export(options, store)
+    else:
+        stats(store)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
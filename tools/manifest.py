@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""The corpus manifest: manifest.json next to the hang files.
+
+One entry per corpus file:
+
+  language   'c', 'c++' or 'fortran' (several .c/.cpp files are gfortran
+             testsuite code: hang30, hang36-38, hang40, hang41.c, hang96,
+             hang97)
+  origin     'gcc-testsuite' (dg- directives or a PR reference),
+             'real-world' (hang.cpp, hang11.cpp, hang19.cpp) or 'fuzzer'
+  bytes      file size; sha1 of the content
+  stage      analysis stage the hang is known to sit in (see
+             hangcorpus.STAGES), from the recorded backtrace, or null
+  signature  hang signature of that backtrace (hangcorpus.hang_signature)
+  history    the last HISTORY_LENGTH runs as {"wall", "status"}; a timeout
+             records the timeout, so it is a lower bound
+
+language, origin, stage and signature are guessed once and may then be
+edited by hand; 'update' only fills them in for new files. bytes and
+sha1 are always refreshed; history is appended to by tools/runcorpus.py.
+
+    tools/manifest.py update        # add new files, drop deleted ones
+    tools/manifest.py show          # one line per file
+"""
+
+import argparse
+import hashlib
+import json
+import math
+import os
+import re
+import statistics
+import sys
+
+import hangcorpus
+
+MANIFEST = os.path.join(hangcorpus.CORPUS_DIR, 'manifest.json')
+
+HISTORY_LENGTH = 20
+
+_FORTRAN_MARKERS = [re.compile(p, re.I) for p in (
+    r'\bsubroutine\b',
+    r'\bend\s+(?:subroutine|program|function|type|module)\b',
+    r'\bimplicit\s+none\b',
+    r'\b(?:co)?dimension\s*\(',
+    r'\(\s*\.\.\s*\)',
+    r'\btype\s*\(\s*\*\s*\)',
+    r'\bcall\s+abort\s*\(',
+    r'\b(?:integer|real|logical|character)\s*(?:\*\s*\d+\s*)?(?:,[^;{}]*)?:\s*:',
+    r'!\s*\{\s*dg-',
+    r'\bPR\s+fortran\b',
+)]
+
+
+def guess_language(path, text):
+    if sum(1 for m in _FORTRAN_MARKERS if m.search(text)) >= 2:
+        return 'fortran'
+    return 'c' if path.endswith('.c') else 'c++'
+
+
+def guess_origin(text):
+    if re.search(r'\{\s*dg\s*-\s*[a-z]|\bPR\s+[a-z+-]+\s*/\s*\d+', text):
+        return 'gcc-testsuite'
+    return 'fuzzer'
+
+
+def describe(path):
+    """Return a fresh manifest entry for path, without history."""
+    text = hangcorpus.read_source(path)
+    frames = hangcorpus.parse_backtrace(hangcorpus.embedded_backtrace(path))
+    return {
+        'language': guess_language(path, text),
+        'origin': guess_origin(text),
+        'bytes': os.path.getsize(path),
+        'sha1': hashlib.sha1(text.encode('latin-1')).hexdigest(),
+        'stage': hangcorpus.hang_stage(frames),
+        'signature': hangcorpus.hang_signature(frames) or None,
+        'history': [],
+    }
+
+
+class Manifest(object):
+    def __init__(self, path=MANIFEST):
+        self.path = path
+        self.files = {}
+        if os.path.exists(path):
+            with open(path) as f:
+                self.files = json.load(f)['files']
+
+    def save(self):
+        tmp = self.path + '.tmp'
+        with open(tmp, 'w') as f:
+            json.dump({'version': 1, 'files': self.files}, f, indent=1, sort_keys=True)
+            f.write('\n')
+        os.replace(tmp, self.path)
+
+    def update(self, root=hangcorpus.CORPUS_DIR):
+        """Sync with the files on disk; returns (added, removed) names."""
+        present = dict((os.path.basename(p), p) for p in hangcorpus.corpus_files(root))
+        removed = sorted(set(self.files) - set(present))
+        for name in removed:
+            del self.files[name]
+        added = []
+        for name, path in present.items():
+            fresh = describe(path)
+            entry = self.files.get(name)
+            if entry is None:
+                self.files[name] = fresh
+                added.append(name)
+            else:
+                entry['bytes'] = fresh['bytes']
+                entry['sha1'] = fresh['sha1']
+        return sorted(added), removed
+
+    def entry(self, name):
+        return self.files.get(os.path.basename(name))
+
+    def record(self, name, result, timeout=None):
+        """Append one run to the history of name (if it is in the manifest)."""
+        entry = self.entry(name)
+        if entry is None:
+            return
+        wall = timeout if result.status == 'timeout' and timeout else result.wall
+        entry['history'].append({'wall': round(wall, 3), 'status': result.status})
+        del entry['history'][:-HISTORY_LENGTH]
+
+    def expected_duration(self, name):
+        """Median recorded wall time of name, or None without history."""
+        entry = self.entry(name)
+        if not entry or not entry['history']:
+            return None
+        return statistics.median(h['wall'] for h in entry['history'])
+
+    def duration_quantile(self, name, q):
+        """Nearest-rank q-quantile of the recorded runs of name, or None.
+
+        A timed out run counts with its timeout, a lower bound of its
+        duration, so a quantile that falls on one is a lower bound too.
+        """
+        entry = self.entry(name)
+        walls = sorted(h['wall'] for h in entry['history']) if entry else []
+        if not walls:
+            return None
+        return walls[min(len(walls) - 1, max(0, int(math.ceil(q * len(walls))) - 1))]
+
+    def certain_hang(self, name, runs):
+        """Whether the last runs (at least one) runs of name all timed out."""
+        entry = self.entry(name)
+        history = entry['history'][-runs:] if entry and runs > 0 else []
+        return len(history) == runs and all(h['status'] == 'timeout' for h in history)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--manifest', default=MANIFEST)
+    parser.add_argument('command', choices=('update', 'show'))
+    options = parser.parse_args()
+
+    manifest = Manifest(options.manifest)
+    if options.command == 'update':
+        added, removed = manifest.update()
+        manifest.save()
+        print('%d files, %d added, %d removed' % (len(manifest.files), len(added), len(removed)))
+        return 0
+    for name in hangcorpus.corpus_files():
+        name = os.path.basename(name)
+        entry = manifest.entry(name)
+        if entry is None:
+            print('%-12s (not in manifest)' % name)
+            continue
+        expected = manifest.expected_duration(name)
+        print('%-12s %-8s %-14s %7d  %-15s %8s  %s' % (
+            name, entry['language'], entry['origin'], entry['bytes'], entry['stage'] or '-',
+            '%.2fs' % expected if expected is not None else '-', entry['signature'] or ''))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
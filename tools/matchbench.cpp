@@ -0,0 +1,190 @@
+/*
+ * matchbench - replay recorded Token::Match calls against the matcher.
+ *
+ *     g++ -O2 -Ilib -o matchbench tools/matchbench.cpp $LIB_OBJECTS
+ *     ./matchbench hang89.*.rec
+ *     ./matchbench --top 40 --budget 50000 corpus.*.rec
+ *
+ * ($LIB_OBJECTS: the lib object files of a cppcheck build.)
+ *
+ * Every record of tools/matchrec.cpp is rebuilt as a short TokenList
+ * (strings through TokenList::addtoken, so the token properties are
+ * computed as in the tokenizer, plus the recorded varids) and matched
+ * until the batch takes --budget ns. The time per call is weighted by
+ * how often the call happened in the recorded run and summed per
+ * pattern family:
+ *
+ *   varid          patterns with %varid%
+ *   alternatives   a|b alternatives, %or%, %oror% (hang89's
+ *                  "%oror%|&&|?|:")
+ *   negation       !!x words
+ *   wildcards      %name%, %type%, %num%, %var%, %str%, %op%, ...
+ *   literal        plain words only (what Token::simpleMatch handles)
+ *
+ * and per pattern for the --top most expensive ones. Tokens the
+ * simplifications change later (flags set by the tokenizer beyond the
+ * string and the varid, links) are not reproduced, so the absolute
+ * numbers are a model of the matcher's cost, not of the analysis.
+ */
+
+#include "settings.h"
+#include "token.h"
+#include "tokenlist.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+    /** Keeps the compiler from dropping the measured calls. */
+    volatile bool sink;
+
+    struct Cost {
+        Cost() : calls(0), ns(0.0) {
+        }
+        unsigned long long calls;
+        double ns;
+    };
+
+    const char *family(const std::string &pattern)
+    {
+        if (pattern.find("%varid%") != std::string::npos)
+            return "varid";
+        if (pattern.find('|') != std::string::npos || pattern.find("%or") != std::string::npos)
+            return "alternatives";
+        if (pattern.find("!!") != std::string::npos)
+            return "negation";
+        if (pattern.find('%') != std::string::npos)
+            return "wildcards";
+        return "literal";
+    }
+
+    std::vector<std::string> split(const std::string &text, char separator)
+    {
+        std::vector<std::string> fields;
+        std::string::size_type start = 0;
+        for (;;) {
+            const std::string::size_type end = text.find(separator, start);
+            fields.push_back(text.substr(start, end - start));
+            if (end == std::string::npos)
+                return fields;
+            start = end + 1;
+        }
+    }
+
+    /** Undo the \\xHH escapes of tools/matchrec.cpp. */
+    std::string unescape(const std::string &text)
+    {
+        std::string result;
+        for (std::string::size_type i = 0; i < text.size(); ++i) {
+            if (text[i] == '\\' && i + 3 < text.size() && text[i + 1] == 'x') {
+                result += static_cast<char>(std::strtoul(text.substr(i + 2, 2).c_str(), 0, 16));
+                i += 3;
+            } else {
+                result += text[i];
+            }
+        }
+        return result;
+    }
+
+    /** Nanoseconds per Token::Match call of one record. */
+    double measure(const Settings &settings, const std::vector<std::string> &fields, double budget)
+    {
+        TokenList tokenlist(&settings);
+        tokenlist.appendFileIfNew("matchbench.cpp");
+        for (std::size_t i = 3; i < fields.size(); ++i) {
+            const std::vector<std::string> tok = split(fields[i], '\x1e');
+            tokenlist.addtoken(unescape(tok[0]), 1, 0);
+            tokenlist.back()->varId(static_cast<unsigned int>(std::strtoul(tok[1].c_str(), 0, 10)));
+        }
+        const Token *first = tokenlist.front();
+        const std::string pattern = unescape(fields[2]);
+        const unsigned int varid = static_cast<unsigned int>(std::strtoul(fields[1].c_str(), 0, 10));
+
+        for (unsigned long iterations = 16;; iterations *= 2) {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (unsigned long i = 0; i < iterations; ++i)
+                sink = Token::Match(first, pattern.c_str(), varid);
+            const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (ns >= budget || iterations >= (1UL << 24))
+                return ns / iterations;
+        }
+    }
+
+    void usage()
+    {
+        std::cerr << "usage: matchbench [--top N] [--budget NS] record-file...\n";
+        std::exit(2);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t top = 20;
+    double budget = 20000.0;
+    std::vector<const char *> files;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+            top = std::strtoul(argv[++i], 0, 10);
+        else if (std::strcmp(argv[i], "--budget") == 0 && i + 1 < argc)
+            budget = std::strtod(argv[++i], 0);
+        else if (argv[i][0] == '-')
+            usage();
+        else
+            files.push_back(argv[i]);
+    }
+    if (files.empty())
+        usage();
+
+    Settings settings;
+    std::map<std::string, Cost> families;
+    std::map<std::string, Cost> patterns;
+    Cost total;
+    for (std::size_t f = 0; f < files.size(); ++f) {
+        std::ifstream in(files[f]);
+        std::string line;
+        while (std::getline(in, line)) {
+            const std::vector<std::string> fields = split(line, '\x1f');
+            if (fields.size() < 3)
+                continue;
+            const unsigned long long count = std::strtoull(fields[0].c_str(), 0, 10);
+            const double ns = measure(settings, fields, budget);
+            Cost *costs[] = { &families[family(fields[2])], &patterns[fields[2]], &total };
+            for (std::size_t c = 0; c < 3; ++c) {
+                costs[c]->calls += count;
+                costs[c]->ns += ns * count;
+            }
+        }
+    }
+    if (!total.calls) {
+        std::cerr << "matchbench: no records\n";
+        return 1;
+    }
+
+    std::printf("%-14s %14s %10s %8s\n", "family", "calls", "ns/match", "share");
+    for (std::map<std::string, Cost>::const_iterator it = families.begin(); it != families.end(); ++it)
+        std::printf("%-14s %14llu %10.1f %7.1f%%\n", it->first.c_str(), it->second.calls,
+                    it->second.ns / it->second.calls, 100.0 * it->second.ns / total.ns);
+    std::printf("%-14s %14llu %10.1f %7.1f%%\n\n", "all", total.calls, total.ns / total.calls, 100.0);
+
+    std::vector<std::pair<double, std::string> > ranked;
+    for (std::map<std::string, Cost>::const_iterator it = patterns.begin(); it != patterns.end(); ++it)
+        ranked.push_back(std::make_pair(it->second.ns, it->first));
+    std::sort(ranked.rbegin(), ranked.rend());
+    if (ranked.size() > top)
+        ranked.resize(top);
+    std::printf("%14s %10s %8s  pattern\n", "calls", "ns/match", "share");
+    for (std::size_t i = 0; i < ranked.size(); ++i) {
+        const Cost &cost = patterns[ranked[i].second];
+        std::printf("%14llu %10.1f %7.1f%%  \"%s\"\n", cost.calls, cost.ns / cost.calls,
+                    100.0 * cost.ns / total.ns, ranked[i].second.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * matchrec - record the Token::Match calls of a cppcheck run.
+ *
+ * Link this file into cppcheck and let the linker route every call of
+ * Token::Match(const Token *, const char [], unsigned int) from another
+ * object file through the wrapper below (no LTO, --wrap works on
+ * undefined references only). $CPPCHECK_OBJECTS are the cli and lib
+ * object files of a normal build:
+ *
+ *     g++ -O2 -Ilib -c tools/matchrec.cpp -o matchrec.o
+ *     g++ -o cppcheck-matchrec $CPPCHECK_OBJECTS matchrec.o \
+ *         -Wl,--wrap=_ZN5Token5MatchEPKS_PKcj
+ *     MATCHREC_OUT=hang89.%p.rec ./cppcheck-matchrec hang89.cpp
+ *
+ * Each distinct call (pattern, varid and the strings and varids of as
+ * many tokens as the pattern has words) is stored once with its call
+ * count, '%p' in MATCHREC_OUT becoming the pid so forked -j workers do
+ * not overwrite each other. tools/matchbench.cpp replays the records
+ * against the matcher alone.
+ *
+ * A hang such as hang89.cpp's Token::Match loop is SIGKILLed at the
+ * timeout and never reaches the static destructor, so the table is also
+ * written every MATCHREC_INTERVAL seconds (default 5) while the run goes
+ * on, to a temporary file renamed over MATCHREC_OUT: a killed run leaves
+ * the last complete snapshot.
+ *
+ * Record format, one call per line, fields separated by \x1f, token
+ * string and varid by \x1e:
+ *
+ *     <count> \x1f <varid> \x1f <pattern> \x1f <str> \x1e <varid> \x1f ...
+ *
+ * Backslashes and bytes below 0x20 in the pattern and the token strings
+ * (string and char literals can hold any of the separators) are written
+ * as \xHH.
+ */
+
+#include "token.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+
+extern "C" bool __real__ZN5Token5MatchEPKS_PKcj(const Token *tok, const char pattern[], unsigned int varid);
+
+namespace {
+    const std::size_t MAX_RECORDS = 2000000;
+
+    /** Append s to out with backslashes and control bytes as \\xHH. */
+    void escape(std::string &out, const char *s, std::size_t size)
+    {
+        for (std::size_t i = 0; i < size; ++i) {
+            const unsigned char c = static_cast<unsigned char>(s[i]);
+            if (c < 0x20 || c == '\\') {
+                char hex[5];
+                std::snprintf(hex, sizeof(hex), "\\x%02x", c);
+                out += hex;
+            } else {
+                out += s[i];
+            }
+        }
+    }
+
+    class Recorder {
+    public:
+        Recorder() : mDropped(0), mCalls(0), mLastWrite(std::chrono::steady_clock::now()) {
+            const char *interval = std::getenv("MATCHREC_INTERVAL");
+            mInterval = std::chrono::duration<double>(interval ? std::strtod(interval, 0) : 5.0);
+        }
+
+        ~Recorder() {
+            write();
+            if (mDropped)
+                std::fprintf(stderr, "matchrec: %llu calls not recorded, table full\n", mDropped);
+        }
+
+        void record(const Token *tok, const char pattern[], unsigned int varid) {
+            std::string key = std::to_string(varid);
+            key += '\x1f';
+            escape(key, pattern, std::strlen(pattern));
+            // One token per pattern word is all Match can look at.
+            bool word = false;
+            for (const char *p = pattern; *p && tok; ++p) {
+                if (*p != ' ' && !word) {
+                    key += '\x1f';
+                    escape(key, tok->str().data(), tok->str().size());
+                    key += '\x1e';
+                    key += std::to_string(tok->varId());
+                    tok = tok->next();
+                }
+                word = *p != ' ';
+            }
+            std::unordered_map<std::string, unsigned long long>::iterator it = mCounts.find(key);
+            if (it != mCounts.end())
+                ++it->second;
+            else if (mCounts.size() < MAX_RECORDS)
+                mCounts[key] = 1;
+            else
+                ++mDropped;
+            // Looking at the clock on every call would cost more than the match.
+            if ((++mCalls & 0xffff) == 0 && std::chrono::steady_clock::now() - mLastWrite >= mInterval) {
+                write();
+                mLastWrite = std::chrono::steady_clock::now();
+            }
+        }
+
+    private:
+        void write() const {
+            const char *pattern = std::getenv("MATCHREC_OUT");
+            std::string path = pattern ? pattern : "matchrec.%p.rec";
+            const std::string::size_type pos = path.find("%p");
+            if (pos != std::string::npos)
+                path.replace(pos, 2, std::to_string(getpid()));
+            const std::string tmp = path + ".tmp";
+            std::FILE *f = std::fopen(tmp.c_str(), "w");
+            if (!f)
+                return;
+            for (std::unordered_map<std::string, unsigned long long>::const_iterator it = mCounts.begin(); it != mCounts.end(); ++it)
+                std::fprintf(f, "%llu\x1f%s\n", it->second, it->first.c_str());
+            if (std::fclose(f) == 0)
+                std::rename(tmp.c_str(), path.c_str());
+        }
+
+        std::unordered_map<std::string, unsigned long long> mCounts;
+        unsigned long long mDropped;
+        unsigned long long mCalls;
+        std::chrono::steady_clock::time_point mLastWrite;
+        std::chrono::duration<double> mInterval;
+    };
+
+    Recorder recorder;
+}
+
+extern "C" bool __wrap__ZN5Token5MatchEPKS_PKcj(const Token *tok, const char pattern[], unsigned int varid)
+{
+    recorder.record(tok, pattern, varid);
+    return __real__ZN5Token5MatchEPKS_PKcj(tok, pattern, varid);
+}
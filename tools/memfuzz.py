@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""Fuzz for memory amplification: maximise peak RSS per input byte.
+
+hang16, hang18 and hang60 grow without bound in
+TemplateSimplifier::expandTemplate -> TokenList::addtoken. This fuzzer
+mutates corpus seeds and scores each input by
+
+    (peak RSS - RSS of an empty input) / input size
+
+so a 200 byte file that makes cppcheck allocate 1 GiB outranks a 50 KiB
+file that needs 100 MiB. Every run is capped with --max-rss (RLIMIT_AS),
+which keeps a single amplifier from taking down the machine; inputs that
+hit the cap are kept with status 'capped' and the cap as a lower bound.
+
+Peak RSS is the measurable proxy for peak live tokens: Token objects
+dominate the heap during template expansion.
+
+The worst --keep amplifiers are kept in --out together with index.json:
+
+    tools/memfuzz.py --binary ./cppcheck --iterations 2000 --out memfuzz
+    tools/memfuzz.py --binary ./cppcheck --dict hang.json
+    tools/memfuzz.py --binary ./cppcheck hang16.cpp hang18.cpp -- --std=c++11
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import random
+import re
+import sys
+import tempfile
+
+import hangcorpus
+from mutator import Mutator
+
+_OUT_OF_MEMORY = re.compile(r'bad_alloc|out of memory|Cannot allocate memory', re.I)
+
+
+def measure(options, path, extra_args):
+    result = hangcorpus.run(options.binary, path, extra_args, timeout=options.timeout,
+                            mem_limit_mb=options.max_rss)
+    status = result.status
+    if status in ('crash', 'error') and (_OUT_OF_MEMORY.search(result.stderr) or
+                                         _OUT_OF_MEMORY.search(result.stdout)):
+        status = 'capped'
+    return status, result
+
+
+def score(maxrss_kb, baseline_kb, size):
+    return max(0, maxrss_kb - baseline_kb) * 1024.0 / max(1, size)
+
+
+class Queue(object):
+    """The kept amplifiers, persisted as <dir>/index.json."""
+
+    def __init__(self, directory, keep):
+        self.directory = directory
+        self.keep = keep
+        self.index_path = os.path.join(directory, 'index.json')
+        self.entries = []
+        if os.path.exists(self.index_path):
+            with open(self.index_path) as f:
+                self.entries = json.load(f)['entries']
+
+    def threshold(self):
+        if len(self.entries) < self.keep:
+            return 0.0
+        return self.entries[-1]['score']
+
+    def add(self, data, ext, entry):
+        name = 'amp-' + hashlib.sha1(data).hexdigest()[:12] + ext
+        if any(e['file'] == name for e in self.entries):
+            return False
+        with open(os.path.join(self.directory, name), 'wb') as f:
+            f.write(data)
+        entry['file'] = name
+        self.entries.append(entry)
+        self.entries.sort(key=lambda e: e['score'], reverse=True)
+        for dropped in self.entries[self.keep:]:
+            os.remove(os.path.join(self.directory, dropped['file']))
+        del self.entries[self.keep:]
+        return True
+
+    def save(self, baseline_kb):
+        tmp = self.index_path + '.tmp'
+        with open(tmp, 'w') as f:
+            json.dump({'baseline_kb': baseline_kb, 'entries': self.entries}, f, indent=1)
+        os.replace(tmp, self.index_path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--binary', required=True, help='cppcheck binary to fuzz')
+    parser.add_argument('--out', default='memfuzz', help='directory for kept amplifiers')
+    parser.add_argument('--iterations', type=int, default=1000)
+    parser.add_argument('--timeout', type=float, default=10.0, help='seconds per run')
+    parser.add_argument('--max-rss', type=int, default=2048, metavar='MB',
+                        help='address space cap per run (default %(default)s MiB)')
+    parser.add_argument('--keep', type=int, default=50, help='number of amplifiers to keep')
+    parser.add_argument('--seed', type=int, help='random seed')
+    parser.add_argument('--dict', help='weighted dictionary from tools/mkdict.py (.json)')
+    parser.add_argument('seeds', nargs='*', help='seed files (default: the whole corpus)')
+    argv = sys.argv[1:]
+    extra_args = []
+    if '--' in argv:
+        extra_args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    options = parser.parse_args(argv)
+
+    seeds = options.seeds or hangcorpus.corpus_files()
+    rng = random.Random(options.seed)
+    mutator = Mutator.from_files(seeds, rng)
+    if options.dict:
+        mutator.load_dictionary(options.dict)
+    os.makedirs(options.out, exist_ok=True)
+    queue = Queue(options.out, options.keep)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        empty = os.path.join(tmp, 'empty.cpp')
+        open(empty, 'w').close()
+        _, baseline = measure(options, empty, extra_args)
+        baseline_kb = baseline.maxrss_kb
+        print('baseline peak RSS: %d KiB' % baseline_kb)
+
+        for iteration in range(options.iterations):
+            # Mostly mutate the current worst amplifiers, sometimes a fresh seed.
+            if queue.entries and rng.random() < 0.8:
+                parent = queue.entries[min(int(rng.expovariate(0.2)), len(queue.entries) - 1)]
+                parent_path = os.path.join(options.out, parent['file'])
+                parent_name = parent['file']
+            else:
+                parent_path = rng.choice(seeds)
+                parent_name = os.path.basename(parent_path)
+            ext = os.path.splitext(parent_path)[1]
+            tokens = [t.str for t in hangcorpus.tokenize(hangcorpus.read_source(parent_path))]
+            data = hangcorpus.join_tokens(mutator.mutate(tokens)).encode('latin-1')
+
+            path = os.path.join(tmp, 'input' + ext)
+            with open(path, 'wb') as f:
+                f.write(data)
+            status, result = measure(options, path, extra_args)
+            maxrss_kb = result.maxrss_kb
+            if status == 'capped':
+                maxrss_kb = max(maxrss_kb, options.max_rss * 1024)
+            value = score(maxrss_kb, baseline_kb, len(data))
+            if value <= queue.threshold():
+                continue
+            entry = {
+                'score': round(value, 1),
+                'status': status,
+                'bytes': len(data),
+                'maxrss_kb': maxrss_kb,
+                'wall': round(result.wall, 3),
+                'parent': parent_name,
+                'iteration': iteration,
+            }
+            if queue.add(data, ext, entry):
+                queue.save(baseline_kb)
+                print('%6d  %-8s %10.1f B/B  %8d KiB  %6d bytes  <- %s' % (
+                    iteration, status, value, maxrss_kb, len(data), parent_name))
+
+    queue.save(baseline_kb)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
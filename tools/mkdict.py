@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""Extract a weighted fuzzing dictionary and n-gram table from the corpus.
+
+The hangs hinge on rare tokens: __builtin_va_arg_pack (hang27),
+codimension / dimension(..) (hang36-38), __complex__ / __imag__ (hang48),
+__attribute__((vector_size(8))) (hang32), #pragma acc (hang56),
+operator- <> (hang7, hang9). A token is weighted by how rare it is across
+files (inverse document frequency) times how often it is used where it
+occurs, so such tokens rank above ';' and 'int'. N-gram rarity does not
+separate them: most n-grams occur in one file only, so the constructs above
+are seeded into the n-gram table (SEED_NGRAMS) whenever the input has them.
+
+Two files are written:
+
+  <out>.dict   AFL / libFuzzer dictionary, tokens then n-grams
+  <out>.json   tokens and n-grams with weights, read by mutator.py
+               (memfuzz.py --dict, diffperf.py --dict)
+
+    tools/mkdict.py --out hang
+    tools/mkdict.py --out templates hang7.cpp hang9.cpp hang63.cpp
+"""
+
+import argparse
+import collections
+import json
+import math
+import os
+import sys
+
+import hangcorpus
+
+MAX_TOKEN_LENGTH = 32
+
+# Source of the hang-specific constructs; lexed with hangcorpus.tokenize so
+# the n-grams match the ones counted from the files.
+SEED_NGRAMS = (
+    '#pragma acc',                        # hang56
+    'operator- <',                        # hang7, hang9
+    'operator- <>',
+    '__builtin_va_arg_pack ()',           # hang27
+    'codimension : :',                    # hang36-38
+    'dimension : :',
+    '( .. )',
+    '__complex__ long double',            # hang48
+    '__attribute__((vector_size(',        # hang32
+)
+
+
+def file_tokens(path):
+    return [t for t in hangcorpus.tokenize(hangcorpus.read_source(path))
+            if len(t.str) <= MAX_TOKEN_LENGTH]
+
+
+def is_local_name(token, tf, df):
+    """True for identifiers and literals that one file uses again and again,
+    such as the member names of hang19. They say nothing about the analyser.
+    Reserved names (__imag__, _Complex) and one-off words such as
+    vector_size or acc are kept."""
+    text = token.str
+    reserved = text.startswith('__') or (text[:1] == '_' and text[1:2].isupper())
+    return (token.kind in ('name', 'string', 'char', 'number') and df[text] == 1
+            and tf[text] > 2 and not reserved)
+
+
+def build(paths, max_n=3, max_tokens=1000, max_ngrams=1000):
+    lexed = [file_tokens(p) for p in paths]
+    count = len(lexed)
+    tf = collections.Counter()
+    df = collections.Counter()
+    for tokens in lexed:
+        tf.update(t.str for t in tokens)
+        df.update(set(t.str for t in tokens))
+    local = set(t.str for tokens in lexed for t in tokens if is_local_name(t, tf, df))
+    documents = [[t.str for t in tokens] for tokens in lexed]
+
+    # Rarity across files dominates; repetition inside a file only breaks ties.
+    token_weight = {}
+    for token, freq in tf.items():
+        if token in local:
+            continue
+        weight = math.log(float(count) / df[token]) * (1 + 0.05 * math.log(freq))
+        if weight > 0:
+            token_weight[token] = weight
+    tokens = sorted(token_weight.items(), key=lambda kv: (-kv[1], kv[0]))[:max_tokens]
+
+    ngram_tf = collections.Counter()
+    ngram_df = collections.Counter()
+    for doc in documents:
+        seen = set()
+        for n in range(2, max_n + 1):
+            for i in range(len(doc) - n + 1):
+                gram = tuple(doc[i:i + n])
+                ngram_tf[gram] += 1
+                seen.add(gram)
+        ngram_df.update(seen)
+    ngrams = []
+    for gram, freq in ngram_tf.items():
+        # An n-gram is as interesting as its rarest token; local names
+        # would only replay one file.
+        if any(t in local for t in gram):
+            continue
+        rarest = max(token_weight.get(t, 0.0) for t in gram)
+        if rarest <= 0:
+            continue
+        ngrams.append((gram, rarest * (1 + 0.05 * math.log(freq)) / math.sqrt(len(gram))))
+    ngrams.sort(key=lambda kv: (-kv[1], kv[0]))
+    ngrams = ngrams[:max_ngrams]
+
+    # Seeds go first, at the top weight, and on top of max_ngrams.
+    top = ngrams[0][1] if ngrams else 1.0
+    seeds = []
+    for source in SEED_NGRAMS:
+        gram = tuple(t.str for t in hangcorpus.tokenize(source))
+        if gram in ngram_tf or contains(documents, gram):
+            seeds.append((gram, top))
+    seeded = set(g for g, _ in seeds)
+    return tokens, seeds + [kv for kv in ngrams if kv[0] not in seeded]
+
+
+def contains(documents, gram):
+    n = len(gram)
+    return any(tuple(doc[i:i + n]) == gram
+               for doc in documents for i in range(len(doc) - n + 1))
+
+
+def escape(text):
+    out = []
+    for ch in text:
+        code = ord(ch)
+        if ch in '"\\':
+            out.append('\\' + ch)
+        elif 32 <= code < 127:
+            out.append(ch)
+        else:
+            out.append('\\x%02x' % (code & 0xff))
+    return ''.join(out)
+
+
+def write_dict(path, tokens, ngrams):
+    entries = tokens + [(' '.join(g), w) for g, w in ngrams]
+    with open(path, 'w') as f:
+        f.write('# generated by tools/mkdict.py; weight in the comment above each entry\n')
+        for n, (text, weight) in enumerate(entries):
+            f.write('# %.3f\n' % weight)
+            f.write('kw%04d="%s"\n' % (n, escape(text)))
+
+
+def write_json(path, tokens, ngrams):
+    with open(path, 'w') as f:
+        json.dump({
+            'tokens': [[t, round(w, 4)] for t, w in tokens],
+            'ngrams': [[list(g), round(w, 4)] for g, w in ngrams],
+        }, f, indent=0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--out', default='hang', help='output prefix (default %(default)s)')
+    parser.add_argument('--max-n', type=int, default=3, help='longest n-gram (default %(default)s)')
+    parser.add_argument('--tokens', type=int, default=1000, help='dictionary tokens to keep')
+    parser.add_argument('--ngrams', type=int, default=1000, help='n-grams to keep')
+    parser.add_argument('files', nargs='*', help='seed files (default: the whole corpus)')
+    options = parser.parse_args()
+
+    paths = options.files or hangcorpus.corpus_files()
+    tokens, ngrams = build(paths, options.max_n, options.tokens, options.ngrams)
+    write_dict(options.out + '.dict', tokens, ngrams)
+    write_json(options.out + '.json', tokens, ngrams)
+    print('%d tokens, %d n-grams from %d files -> %s.dict, %s.json' % (
+        len(tokens), len(ngrams), len(paths), options.out, os.path.basename(options.out)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
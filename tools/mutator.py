@@ -0,0 +1,135 @@
+"""Token-level mutations of corpus inputs.
+
+Most hangs in this corpus are mangled copies of a compilable program:
+a bracket moved, a range of tokens repeated, two programs spliced
+together. The mutations below do the same on the token stream produced
+by hangcorpus.tokenize(), which keeps the outputs lexically plausible.
+"""
+
+import bisect
+import itertools
+import json
+import random
+
+import hangcorpus
+
+
+class _Weighted(object):
+    """Weighted random choice in O(log n)."""
+
+    def __init__(self, items):
+        self.values = [value for value, _ in items]
+        self.cumulative = list(itertools.accumulate(weight for _, weight in items))
+
+    def choice(self, rng):
+        r = rng.random() * self.cumulative[-1]
+        return self.values[bisect.bisect_right(self.cumulative, r)]
+
+
+class Mutator(object):
+    def __init__(self, seeds, rng=None):
+        """seeds is a list of token string lists used for splicing and as
+        the pool of tokens to insert."""
+        self.rng = rng or random.Random()
+        self.seeds = [s for s in seeds if s]
+        self.pool = sorted(set(t for s in self.seeds for t in s))
+        self.mutations = [
+            self.delete_range,
+            self.duplicate_range,
+            self.repeat_range,
+            self.swap_tokens,
+            self.insert_token,
+            self.replace_token,
+            self.splice,
+        ]
+        self.dictionary = None
+        self.continuations = {}
+
+    def load_dictionary(self, path):
+        """Enable the dictionary mutations with a tools/mkdict.py .json file.
+
+        Dictionary entries are inserted with probability proportional to
+        their weight; n-grams additionally drive a continuation mutation
+        that extends a token with what followed it in the corpus.
+        """
+        with open(path) as f:
+            data = json.load(f)
+        entries = [([token], weight) for token, weight in data['tokens']]
+        entries += [(gram, weight) for gram, weight in data['ngrams']]
+        self.dictionary = _Weighted(entries)
+        continuations = {}
+        for gram, weight in data['ngrams']:
+            continuations.setdefault(gram[0], []).append((gram[1:], weight))
+        self.continuations = dict((k, _Weighted(v)) for k, v in continuations.items())
+        self.mutations.extend([self.insert_dictionary, self.insert_dictionary,
+                               self.continue_ngram])
+
+    @classmethod
+    def from_files(cls, paths, rng=None):
+        seeds = [[t.str for t in hangcorpus.tokenize(hangcorpus.read_source(p))]
+                 for p in paths]
+        return cls(seeds, rng)
+
+    def _range(self, tokens, max_len=16):
+        start = self.rng.randrange(len(tokens))
+        end = min(len(tokens), start + self.rng.randint(1, max_len))
+        return start, end
+
+    def delete_range(self, tokens):
+        start, end = self._range(tokens)
+        return tokens[:start] + tokens[end:]
+
+    def duplicate_range(self, tokens):
+        start, end = self._range(tokens)
+        at = self.rng.randrange(len(tokens) + 1)
+        return tokens[:at] + tokens[start:end] + tokens[at:]
+
+    def repeat_range(self, tokens):
+        # Repetition is what turns a slow construct into an amplifier.
+        start, end = self._range(tokens, 32)
+        count = self.rng.choice((2, 4, 8, 16))
+        return tokens[:end] + tokens[start:end] * (count - 1) + tokens[end:]
+
+    def swap_tokens(self, tokens):
+        out = list(tokens)
+        i = self.rng.randrange(len(out))
+        j = self.rng.randrange(len(out))
+        out[i], out[j] = out[j], out[i]
+        return out
+
+    def insert_token(self, tokens):
+        at = self.rng.randrange(len(tokens) + 1)
+        return tokens[:at] + [self.rng.choice(self.pool)] + tokens[at:]
+
+    def replace_token(self, tokens):
+        out = list(tokens)
+        out[self.rng.randrange(len(out))] = self.rng.choice(self.pool)
+        return out
+
+    def splice(self, tokens):
+        other = self.rng.choice(self.seeds)
+        start, end = self._range(other, 64)
+        at = self.rng.randrange(len(tokens) + 1)
+        return tokens[:at] + other[start:end] + tokens[at:]
+
+    def insert_dictionary(self, tokens):
+        at = self.rng.randrange(len(tokens) + 1)
+        return tokens[:at] + self.dictionary.choice(self.rng) + tokens[at:]
+
+    def continue_ngram(self, tokens):
+        starts = [i for i in range(len(tokens)) if tokens[i] in self.continuations]
+        if not starts:
+            return self.insert_dictionary(tokens)
+        at = self.rng.choice(starts)
+        tail = self.continuations[tokens[at]].choice(self.rng)
+        return tokens[:at + 1] + tail + tokens[at + 1:]
+
+    def mutate(self, tokens, rounds=None):
+        """Apply 1..4 random mutations (or rounds of them) to a token list."""
+        if rounds is None:
+            rounds = self.rng.randint(1, 4)
+        for _ in range(rounds):
+            if not tokens:
+                tokens = list(self.rng.choice(self.seeds))
+            tokens = self.rng.choice(self.mutations)(tokens)
+        return tokens
@@ -0,0 +1,250 @@
+/*
+ * perfstat - count hardware events of one command, optionally per stage.
+ *
+ *     cc -O2 -o perfstat tools/perfstat.c
+ *     ./perfstat -o counts.json -- ./cppcheck hang19.cpp
+ *
+ * Counts instructions, cycles, cache misses and branch misses (user
+ * space only, so perf_event_paranoid=2 is enough) and page faults of
+ * the command and every process it starts. Counters that the kernel had
+ * to multiplex are scaled by time enabled / time running.
+ *
+ * Stage markers: the command finds the write end of a pipe in the
+ * PERFSTAT_MARKER_FD environment variable and writes one line with a
+ * stage or timer name whenever it enters a new stage. The counters are
+ * read at every marker, and the JSON gets one segment per marker with
+ * the counts since the previous one. cppcheck has no such hook; a local
+ * patch to the Timer constructor in lib/timer.cpp is enough:
+ *
+ *     static int fd = getenv("PERFSTAT_MARKER_FD") ? atoi(getenv("PERFSTAT_MARKER_FD")) : -1;
+ *     if (fd >= 0) { std::string line = str + "\n"; write(fd, line.data(), line.size()); }
+ *
+ * Markers arrive through a pipe, so a segment boundary is only accurate
+ * to the latency of one read; segments shorter than that mean nothing.
+ * The exit status is the command's; a command killed by a signal kills
+ * perfstat with the same signal.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct counter {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+    int fd;
+    uint64_t last;
+};
+
+static struct counter counters[] = {
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, 0 },
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, 0 },
+    { "cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1, 0 },
+    { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1, 0 },
+    { "page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, -1, 0 },
+};
+
+#define NCOUNTERS (sizeof(counters) / sizeof(counters[0]))
+
+static FILE *out;
+static int segments;
+
+static int open_counter(struct counter *c, pid_t pid)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = c->type;
+    attr.config = c->config;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    c->fd = (int)syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    return c->fd;
+}
+
+static uint64_t read_counter(const struct counter *c)
+{
+    uint64_t values[3];
+    if (c->fd < 0 || read(c->fd, values, sizeof(values)) != sizeof(values))
+        return 0;
+    if (values[2] && values[2] < values[1])
+        return (uint64_t)((double)values[0] * values[1] / values[2]);
+    return values[0];
+}
+
+static void write_json_string(const char *s)
+{
+    fputc('"', out);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\')
+            fprintf(out, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(out, "\\u%04x", *s);
+        else
+            fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+/* Write the counts since the previous segment and start a new one. */
+static void segment(const char *marker)
+{
+    size_t i;
+    fprintf(out, "%s\n  {\"marker\": ", segments++ ? "," : "");
+    write_json_string(marker);
+    for (i = 0; i < NCOUNTERS; ++i) {
+        const uint64_t now = read_counter(&counters[i]);
+        if (counters[i].fd >= 0)
+            fprintf(out, ", \"%s\": %llu", counters[i].name,
+                    (unsigned long long)(now - counters[i].last));
+        counters[i].last = now;
+    }
+    fputc('}', out);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: perfstat [-o FILE] -- command [args...]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *output = NULL;
+    int go[2], markers[2];
+    char pending[4096] = "";
+    size_t pending_len = 0;
+    char current[4096] = "start";
+    const char *sep = "";
+    int status = 0, opt, exited = 0;
+    size_t i, opened = 0;
+    pid_t pid;
+
+    while ((opt = getopt(argc, argv, "o:")) != -1) {
+        if (opt == 'o')
+            output = optarg;
+        else
+            usage();
+    }
+    if (optind >= argc)
+        usage();
+
+    if (pipe(go) || pipe(markers)) {
+        perror("perfstat: pipe");
+        return 2;
+    }
+    pid = fork();
+    if (pid < 0) {
+        perror("perfstat: fork");
+        return 2;
+    }
+    if (pid == 0) {
+        char fd[16];
+        char c;
+        close(go[1]);
+        close(markers[0]);
+        snprintf(fd, sizeof(fd), "%d", markers[1]);
+        setenv("PERFSTAT_MARKER_FD", fd, 1);
+        /* Wait until the counters are attached; they start at exec. */
+        if (read(go[0], &c, 1) != 1)
+            _exit(127);
+        close(go[0]);
+        execvp(argv[optind], argv + optind);
+        perror(argv[optind]);
+        _exit(127);
+    }
+    close(go[0]);
+    close(markers[1]);
+
+    for (i = 0; i < NCOUNTERS; ++i) {
+        if (open_counter(&counters[i], pid) >= 0)
+            ++opened;
+        else
+            fprintf(stderr, "perfstat: %s: %s\n", counters[i].name, strerror(errno));
+    }
+    if (!opened) {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return 2;
+    }
+    out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        perror(output);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return 2;
+    }
+    fprintf(out, "{\"segments\": [");
+    if (write(go[1], "x", 1) != 1) {
+        perror("perfstat: start");
+        return 2;
+    }
+    close(go[1]);
+
+    for (;;) {
+        struct pollfd p = { markers[0], POLLIN, 0 };
+        const int ready = poll(&p, 1, exited ? 0 : 100);
+        if (ready > 0) {
+            const ssize_t n = read(markers[0], pending + pending_len, sizeof(pending) - 1 - pending_len);
+            if (n > 0) {
+                char *line, *nl;
+                pending_len += (size_t)n;
+                pending[pending_len] = '\0';
+                line = pending;
+                while ((nl = strchr(line, '\n')) != NULL) {
+                    *nl = '\0';
+                    segment(current);
+                    snprintf(current, sizeof(current), "%s", line);
+                    line = nl + 1;
+                }
+                pending_len = strlen(line);
+                memmove(pending, line, pending_len + 1);
+                if (pending_len == sizeof(pending) - 1)
+                    pending_len = 0;
+                continue;
+            }
+            if (n == 0) {
+                /* Every writer is gone; only the exit status is missing. */
+                if (!exited)
+                    waitpid(pid, &status, 0);
+                break;
+            }
+        }
+        if (exited)
+            break;
+        if (waitpid(pid, &status, WNOHANG) == pid)
+            exited = 1;
+    }
+    segment(current);
+    fprintf(out, "\n],\n \"status\": %d,\n \"totals\": {", status);
+    for (i = 0; i < NCOUNTERS; ++i) {
+        if (counters[i].fd < 0)
+            continue;
+        fprintf(out, "%s\"%s\": %llu", sep, counters[i].name, (unsigned long long)counters[i].last);
+        sep = ", ";
+    }
+    fprintf(out, "}}\n");
+    fclose(out);
+
+    if (WIFSIGNALED(status)) {
+        signal(WTERMSIG(status), SIG_DFL);
+        raise(WTERMSIG(status));
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 2;
+}
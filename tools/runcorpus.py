@@ -0,0 +1,443 @@
+#!/usr/bin/env python3
+"""Run the corpus against one cppcheck binary.
+
+Files are scheduled longest-first by the median duration recorded in
+manifest.json (files without history go first), which keeps the slow
+tail off the end of a parallel run. Each run is appended to the
+manifest history unless --no-record is given.
+
+With --stages only files whose known hang stage is one of the given
+stages are run; files with an unknown stage always run. Files outside
+the stages are skipped, or run with the short --fast-path timeout as a
+smoke test:
+
+    tools/runcorpus.py --binary ./cppcheck -j8
+    tools/runcorpus.py --binary ./cppcheck --stages templates --fast-path 5
+    tools/runcorpus.py --binary ./cppcheck --backtrace hang16.cpp -- --enable=all
+    tools/runcorpus.py --binary ./cppcheck --pack queue.hcpk
+    systemd-run --user --scope -p Delegate=yes tools/runcorpus.py --binary ./cppcheck \
+        --cgroup self --memory-max 2048 --cpu-max 1 --pids-max 64
+
+With --pack the inputs are members of a tools/corpuspack.py archive;
+each member is written to a temporary file only while it is analysed.
+Only members that are corpus files (the same name at the top of the
+pack and the same content) use and extend the manifest history.
+
+With --files-from the inputs (paths, or member names with --pack) are
+read one per line from a file or a pipe and never held in memory as a
+whole: at most twice --jobs inputs are in flight, and each result is
+written as one JSON line to stdout as soon as it completes. The
+manifest is neither read nor touched, so --stages, --fast-path and
+--adaptive do not combine with it. --checkpoint keeps the position in the list
+(everything before a low-watermark plus the completed inputs after it)
+so an interrupted run resumes where it stopped; it assumes the same
+list in the same order, and results completed after the last save are
+reported again:
+
+    find findings -type f | tools/runcorpus.py --binary ./cppcheck \
+        --files-from - --checkpoint nightly.ckpt > nightly.jsonl
+
+With --adaptive K a file with history starts at K times the p99 of its
+recorded durations (at least --min-timeout) instead of --timeout; a
+timed out run counts with its timeout, a lower bound. Only a file that
+runs out of that budget is retried, with the budget multiplied by
+--escalation each time, as long as the budgets spent on the file add
+up to no more than --timeout. A file that then finishes is reported as
+'slow', one that runs out as 'hang'. A file whose last --known-hang
+runs all timed out is a certain hang: it gets a single --min-timeout
+run, reported as 'hang' unless it now finishes. So certain hangs cost
+little and loaded boxes do not flag slow but legal inputs such as
+hang19.cpp:
+
+    tools/runcorpus.py --binary ./cppcheck --adaptive 3 --timeout 300
+
+With --perf the analyser runs under tools/perfstat.c, and the results
+get instruction, cycle, cache miss, branch miss and page fault counts,
+split by stage when the analyser writes stage markers:
+
+    tools/runcorpus.py --binary ./cppcheck --perf ./perfstat --json counts.json
+
+With --cgroup every analysis runs in its own transient cgroup v2 leaf
+below the given directory, or below the runner's own cgroup with
+'self'; the runner must already be inside it (see
+hangcorpus.CgroupLimits for the setup). Each leaf gets the
+--memory-max, --cpu-max and --pids-max limits; the exact CPU time and
+memory.peak of the leaf are reported under "cgroup" in the results.
+
+Exits with 1 when any file timed out or crashed.
+"""
+
+import argparse
+import collections
+import concurrent.futures
+import contextlib
+import hashlib
+import json
+import os
+import shutil
+import sys
+import tempfile
+import threading
+import time
+
+import hangcorpus
+from corpuspack import Pack, check_name
+from manifest import Manifest, MANIFEST
+
+
+class PackSource(object):
+    """Corpus inputs read from a pack instead of the file system."""
+
+    def __init__(self, path):
+        self.pack = Pack(path)
+        self.lock = threading.Lock()
+        self.tmp = tempfile.mkdtemp(prefix='runcorpus-')
+
+    def size(self, name):
+        return self.pack.size(self.pack.find(name))
+
+    def materialize(self, name):
+        with self.lock:
+            data = self.pack.read_name(name)
+        path = os.path.join(self.tmp, check_name(name))
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, 'wb') as f:
+            f.write(data)
+        return path
+
+    def release(self, path):
+        os.remove(path)
+
+    def close(self):
+        self.pack.close()
+        shutil.rmtree(self.tmp, ignore_errors=True)
+
+
+class PackManifest(Manifest):
+    """The manifest as seen from a pack: a member has the entry and the
+    history of a corpus file only if it is that file, with the same name
+    at the top of the pack and the same content. A fuzz queue member that
+    happens to be called hang16.cpp is not hang16.cpp."""
+
+    def __init__(self, path, pack):
+        Manifest.__init__(self, path)
+        self.members = set()
+        for name, entry in self.files.items():
+            i = pack.find(name)
+            if i >= 0 and hashlib.sha1(pack.read(i)).hexdigest() == entry['sha1']:
+                self.members.add(name)
+
+    def entry(self, name):
+        return Manifest.entry(self, name) if name in self.members else None
+
+
+def schedule(paths, manifest, size=os.path.getsize):
+    """Order paths longest expected duration first."""
+    def key(path):
+        expected = manifest.expected_duration(path)
+        if expected is None:
+            return (0, -size(path))
+        return (1, -expected)
+    return sorted(paths, key=key)
+
+
+def initial_timeout(path, manifest, options):
+    """Starting budget of path under --adaptive, or None without history."""
+    p99 = manifest.duration_quantile(path, 0.99)
+    if p99 is None:
+        return None
+    return min(options.timeout, max(options.min_timeout, p99 * options.adaptive))
+
+
+def plan(paths, manifest, options, size=os.path.getsize):
+    """Return [(path, timeout, escalate, known hang)] for the files to run."""
+    jobs = []
+    stages = set(options.stages.split(',')) if options.stages else None
+    for path in schedule(paths, manifest, size):
+        entry = manifest.entry(path)
+        timeout = options.timeout
+        escalate = known = False
+        if stages is not None and entry and entry['stage'] and entry['stage'] not in stages:
+            if not options.fast_path:
+                continue
+            timeout = options.fast_path
+        elif options.adaptive and manifest.certain_hang(path, options.known_hang):
+            timeout = min(timeout, options.min_timeout)
+            known = True
+        elif options.adaptive:
+            timeout = initial_timeout(path, manifest, options) or timeout
+            escalate = True
+        jobs.append((path, timeout, escalate, known))
+    return jobs
+
+
+def analyse(options, path, timeout, source=None, escalate=False):
+    """Run path; returns (result, frames, final timeout, escalations).
+
+    With escalate a timeout is retried with a larger budget until the
+    run finishes or a larger budget would take the budgets spent on path
+    past options.timeout.
+    """
+    snapshot = []
+
+    def on_timeout(pid):
+        if options.perf:
+            # pid is perfstat, waiting in waitpid(); the analyser is its child.
+            children = hangcorpus.child_pids(pid)
+            if not children:
+                return
+            pid = children[0]
+        snapshot.append(hangcorpus.gdb_batch(pid, ['bt']))
+
+    binary, args = options.binary, options.args
+    if options.perf:
+        counts = tempfile.NamedTemporaryFile(suffix='.json', delete=False)
+        counts.close()
+        binary, args = options.perf, ['-o', counts.name, '--', options.binary] + args
+    escalations = 0
+    spent = 0.0
+    target = source.materialize(path) if source else path
+    try:
+        while True:
+            budget = min(options.timeout - spent - timeout, timeout * options.escalation)
+            final = not escalate or budget <= timeout
+            result = hangcorpus.run(binary, target, args, timeout=timeout,
+                                    on_timeout=on_timeout if options.backtrace and final else None,
+                                    cgroup=options.cgroup)
+            if result.status != 'timeout' or final:
+                break
+            spent += timeout
+            timeout = budget
+            escalations += 1
+    finally:
+        if source:
+            source.release(target)
+        if options.perf:
+            counters = hangcorpus.read_perfstat(counts.name)
+            os.remove(counts.name)
+    if options.perf:
+        result.counters = counters
+    frames = hangcorpus.parse_backtrace(snapshot[0]) if snapshot else []
+    return result, frames, timeout, escalations
+
+
+class Checkpoint(object):
+    """Progress through an input list: a low-watermark sequence number
+    and the completed sequence numbers above it (at most the in-flight
+    window of them)."""
+
+    def __init__(self, path=None):
+        self.path = path
+        self.watermark = 0
+        self.done = set()
+        if path and os.path.exists(path):
+            with open(path) as f:
+                data = json.load(f)
+            self.watermark = data['watermark']
+            self.done = set(data['done'])
+
+    def skip(self, seq):
+        return seq < self.watermark or seq in self.done
+
+    def complete(self, seq):
+        self.done.add(seq)
+        while self.watermark in self.done:
+            self.done.remove(self.watermark)
+            self.watermark += 1
+
+    def save(self):
+        if not self.path:
+            return
+        with open(self.path + '.tmp', 'w') as f:
+            json.dump({'watermark': self.watermark, 'done': sorted(self.done)}, f)
+        os.replace(self.path + '.tmp', self.path)
+
+
+def describe(result, frames, timeout, escalations=None):
+    """Result record; escalations is not None for --adaptive runs."""
+    record = result.as_dict()
+    record['timeout'] = timeout
+    if escalations is not None:
+        record['escalations'] = escalations
+        if result.status == 'timeout':
+            record['verdict'] = 'hang'
+        elif escalations:
+            record['verdict'] = 'slow'
+    if frames:
+        record['signature'] = hangcorpus.hang_signature(frames)
+        record['stage'] = hangcorpus.hang_stage(frames)
+    return record
+
+
+def stream(options, source, out=sys.stdout):
+    """Run the inputs listed in options.files_from with bounded memory."""
+    with (contextlib.nullcontext(sys.stdin) if options.files_from == '-'
+          else open(options.files_from)) as lines:
+        return _stream(options, source, lines, out)
+
+
+def _stream(options, source, lines, out):
+    inputs = enumerate(line.rstrip('\n') for line in lines if line.strip())
+    checkpoint = Checkpoint(options.checkpoint)
+    window = 2 * options.jobs
+    counts = collections.Counter()
+    pending = {}
+    saved = time.time()
+    exhausted = False
+    try:
+        with concurrent.futures.ThreadPoolExecutor(options.jobs) as pool:
+            while pending or not exhausted:
+                while not exhausted and len(pending) < window:
+                    item = next(inputs, None)
+                    if item is None:
+                        exhausted = True
+                    elif not checkpoint.skip(item[0]):
+                        future = pool.submit(analyse, options, item[1], options.timeout, source)
+                        pending[future] = item
+                if not pending:
+                    break
+                done, _ = concurrent.futures.wait(pending, return_when=concurrent.futures.FIRST_COMPLETED)
+                for future in done:
+                    seq, path = pending.pop(future)
+                    result, frames, _, _ = future.result()
+                    record = describe(result, frames, options.timeout)
+                    record['input'] = path
+                    out.write(json.dumps(record, sort_keys=True) + '\n')
+                    counts[result.status] += 1
+                    checkpoint.complete(seq)
+                if time.time() - saved >= options.checkpoint_interval:
+                    out.flush()
+                    checkpoint.save()
+                    saved = time.time()
+    finally:
+        out.flush()
+        checkpoint.save()
+    sys.stderr.write('%d inputs: %s\n' % (sum(counts.values()), ', '.join(
+        '%d %s' % (n, s) for s, n in sorted(counts.items()))))
+    return counts
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--binary', required=True, help='cppcheck binary')
+    parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(), help='parallel runs')
+    parser.add_argument('--timeout', type=float, default=60.0,
+                        help='seconds per file; the ceiling with --adaptive')
+    parser.add_argument('--adaptive', type=float, metavar='K',
+                        help='start each file at K x the p99 of its history and escalate')
+    parser.add_argument('--min-timeout', type=float, default=2.0, metavar='SECONDS',
+                        help='floor of the --adaptive starting budget')
+    parser.add_argument('--escalation', type=float, default=4.0, metavar='FACTOR',
+                        help='budget multiplier per --adaptive retry')
+    parser.add_argument('--known-hang', type=int, default=3, metavar='N',
+                        help='with --adaptive, give files whose last N runs timed out one '
+                             '--min-timeout run (0: never)')
+    parser.add_argument('--manifest', default=MANIFEST)
+    parser.add_argument('--stages', help='comma separated stages the change can affect')
+    parser.add_argument('--fast-path', type=float, metavar='SECONDS',
+                        help='run files outside --stages with this timeout instead of skipping')
+    parser.add_argument('--backtrace', action='store_true',
+                        help='take a gdb backtrace of timed out runs')
+    parser.add_argument('--no-record', action='store_true',
+                        help='do not add the durations to the manifest history')
+    parser.add_argument('--json', metavar='FILE', help='write per-file results as JSON')
+    parser.add_argument('--pack', help='read the inputs from a tools/corpuspack.py archive')
+    parser.add_argument('--perf', metavar='PERFSTAT',
+                        help='count hardware events with this tools/perfstat.c binary')
+    parser.add_argument('--cgroup', metavar='DIR',
+                        help="run each file in a cgroup v2 leaf below this directory "
+                             "('self': the runner's own, delegated cgroup)")
+    parser.add_argument('--memory-max', type=int, metavar='MB', help='memory.max per file')
+    parser.add_argument('--cpu-max', type=float, metavar='CPUS', help='cpu.max per file in CPUs')
+    parser.add_argument('--pids-max', type=int, metavar='N', help='pids.max per file')
+    parser.add_argument('--files-from', metavar='FILE',
+                        help="stream inputs listed in FILE, '-' for stdin, as JSON lines")
+    parser.add_argument('--checkpoint', metavar='FILE', help='resume state for --files-from')
+    parser.add_argument('--checkpoint-interval', type=float, default=30.0, metavar='SECONDS')
+    parser.add_argument('files', nargs='*',
+                        help='inputs (default: the whole corpus or every member of --pack)')
+    argv = sys.argv[1:]
+    args = []
+    if '--' in argv:
+        args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    options = parser.parse_args(argv)
+    options.args = args
+    if options.stages:
+        unknown = set(options.stages.split(',')) - set(hangcorpus.STAGES)
+        if unknown:
+            parser.error('unknown stage(s) %s; known: %s' % (
+                ','.join(sorted(unknown)), ','.join(hangcorpus.STAGES)))
+
+    if options.adaptive and options.files_from:
+        parser.error('--adaptive needs the manifest history, not --files-from')
+    if (options.stages or options.fast_path) and options.files_from:
+        parser.error('--stages and --fast-path need the manifest stages, not --files-from')
+    if options.fast_path and not options.stages:
+        parser.error('--fast-path needs --stages')
+    if options.checkpoint and not options.files_from:
+        parser.error('--checkpoint needs --files-from')
+    if options.cgroup:
+        options.cgroup = hangcorpus.CgroupLimits(options.cgroup, options.memory_max,
+                                                 options.cpu_max, options.pids_max)
+        try:
+            options.cgroup.check()
+        except OSError as e:
+            parser.error('--cgroup: %s' % e)
+    elif options.memory_max or options.cpu_max or options.pids_max:
+        parser.error('--memory-max, --cpu-max and --pids-max need --cgroup')
+
+    source = PackSource(options.pack) if options.pack else None
+    if options.files_from:
+        try:
+            counts = stream(options, source)
+        finally:
+            if source:
+                source.close()
+        return 1 if counts['timeout'] or counts['crash'] else 0
+
+    manifest = PackManifest(options.manifest, source.pack) if source else Manifest(options.manifest)
+    if source:
+        jobs = plan(options.files or source.pack.names(), manifest, options, source.size)
+    else:
+        jobs = plan(options.files or hangcorpus.corpus_files(), manifest, options)
+    lock = threading.Lock()
+    results = {}
+    counts = collections.Counter()
+
+    with concurrent.futures.ThreadPoolExecutor(options.jobs) as pool:
+        futures = dict((pool.submit(analyse, options, path, timeout, source, escalate),
+                        (path, escalate or known))
+                       for path, timeout, escalate, known in jobs)
+        for future in concurrent.futures.as_completed(futures):
+            path, verdict = futures[future]
+            result, frames, timeout, escalations = future.result()
+            # Pack members are unique relative paths; keep them apart.
+            name = path if source else os.path.basename(path)
+            record = describe(result, frames, timeout, escalations if verdict else None)
+            with lock:
+                results[name] = record
+                counts[result.status] += 1
+                entry = manifest.entry(path)
+                if not options.no_record:
+                    manifest.record(path, result, timeout)
+                if entry and frames and not entry['stage']:
+                    entry['stage'] = record['stage']
+                    entry['signature'] = record['signature'] or None
+            print('%-12s %-8s %8.3fs %8d KiB  %s' % (
+                name, record.get('verdict', result.status), result.wall, result.maxrss_kb, record.get('signature', '')))
+            sys.stdout.flush()
+
+    if source:
+        source.close()
+    if not options.no_record or options.backtrace:
+        manifest.save()
+    if options.json:
+        with open(options.json, 'w') as f:
+            json.dump(results, f, indent=1, sort_keys=True)
+    print('%d files: %s' % (len(jobs), ', '.join('%d %s' % (n, s) for s, n in sorted(counts.items()))))
+    return 1 if counts['timeout'] or counts['crash'] else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
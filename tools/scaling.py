@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""Measure how analysis cost grows with the size of hang constructs.
+
+Each family scales the construct one corpus seed is built around:
+
+  ternary      nested conditional operators (hang86)
+  catch        catch clauses of one try block (hang69, hang76)
+  statements   repeated 'bar (val & (1<<k) ? "1" : "2") ;' (hang79)
+  templates    depth of a template instantiation tower (hang63),
+               from tools/gentemplates.py
+
+These are the seeds whose construct is known; the other corpus files
+have no family yet. Scaling a seed needs its triggering construct
+picked out by hand (tools/cmin.py narrows it down), so each new one is
+a generator here plus a FAMILIES entry naming the seed it scales.
+
+Every family is analysed at sizes 1, 2, 4 .. 2**--max-power with
+--showtime=summary. The growth exponent k of t ~ n**k is fitted per
+stage (hangcorpus.stage_times) over the largest sizes that take
+measurable time. With --baseline an exponent that grew by more than
+--tolerance is a regression (exit 1), so a linear pass turning
+quadratic is caught while the inputs are still small. A family that
+times out at a size the baseline finished is a regression as well:
+
+    tools/scaling.py --binary ./cppcheck --save scaling.json
+    tools/scaling.py --binary ./cppcheck --baseline scaling.json ternary catch
+"""
+
+import argparse
+import json
+import os
+import sys
+import tempfile
+
+import benchstats
+import gentemplates
+import hangcorpus
+
+MIN_SECONDS = 0.005
+
+
+def ternary(n):
+    expr = str(n + 1)
+    for k in range(n, 0, -1):
+        # Cycle the bound so every literal fits unsigned long long.
+        expr = '( uv < 0x%xULL ) ? %d : ( %s )' % (0x80 << (4 * ((k - 1) % 15)), k, expr)
+    return ('extern void abort ( void ) ; int main ( ) { int x ; '
+            'unsigned long long uv = 0x1000000001ULL ; x = %s ; '
+            'if ( x != %d ) abort ( ) ; return 0 ; }\n' % (expr, n + 1))
+
+
+def catch(n):
+    out = ['extern "C" void abort ( ) ; struct A { int m ; virtual ~A ( ) { } } ;']
+    out += ['struct S%d : virtual A { int m ; } ;' % k for k in range(n)]
+    out.append('void check ( A *d ) { int caught ; caught = 0 ; try { throw d ; }')
+    out += ['catch ( S%d *p ) { abort ( ) ; }' % k for k in range(n)]
+    out.append('catch ( A *p ) { caught = 1 ; if ( p != d ) abort ( ) ; } '
+               'catch ( ... ) { abort ( ) ; } if ( ! caught ) abort ( ) ; }')
+    return '\n'.join(out) + '\n'
+
+
+def statements(n):
+    body = ' '.join('bar (val & (1<<%d) ? "1" : "2") ;' % (k % 32) for k in range(n))
+    return ('void bar(char *p) { } static inline void foo (unsigned long base , unsigned char val) '
+            '{ val ^= (1<<2) ; %s } int main (void) { foo (23 , 1) ; return 0 ; }\n' % body)
+
+
+def templates(n):
+    return gentemplates.generate(depth=n, fanout=1)
+
+
+FAMILIES = (
+    ('ternary', ternary, 'hang86.cpp'),
+    ('catch', catch, 'hang69.cpp'),
+    ('statements', statements, 'hang79.c'),
+    ('templates', templates, 'hang63.cpp'),
+)
+
+
+def measure(options, family, generate, ext):
+    """Return ([(n, {'total': s, stage: s})], n that timed out or None).
+
+    Each point is the minimum of --repeats runs; the family stops at the
+    first size that times out.
+    """
+    points = []
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, family + ext)
+        for power in range(options.max_power + 1):
+            n = 2 ** power
+            with open(path, 'w') as f:
+                f.write(generate(n))
+            best = None
+            for _ in range(options.repeats):
+                result = hangcorpus.run(options.binary, path, ['--showtime=summary'] + options.args,
+                                        timeout=options.timeout)
+                if result.status == 'timeout':
+                    return points, n
+                timers = hangcorpus.parse_showtime(result.stdout)
+                times = hangcorpus.stage_times(timers)
+                times.pop(None, None)
+                times['total'] = hangcorpus.total_time(timers)
+                best = times if best is None else dict((k, min(v, best[k])) for k, v in times.items())
+            points.append((n, best))
+    return points, None
+
+
+def exponents(points, fit_points):
+    """{metric: (k, r2)} over the largest fit_points measurable sizes."""
+    fitted = {}
+    for metric in ('total',) + hangcorpus.STAGES:
+        usable = [(n, t[metric]) for n, t in points if t.get(metric, 0) >= MIN_SECONDS]
+        k, r2 = benchstats.fit_exponent(usable[-fit_points:])
+        if k is not None:
+            fitted[metric] = (round(k, 3), round(r2, 3))
+    return fitted
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--binary', required=True, help='cppcheck binary')
+    parser.add_argument('--max-power', type=int, default=8, help='largest size is 2**N')
+    parser.add_argument('--repeats', type=int, default=3, help='runs per size, the fastest counts')
+    parser.add_argument('--fit-points', type=int, default=4, help='largest sizes used for the fit')
+    parser.add_argument('--timeout', type=float, default=120.0, help='seconds per run')
+    parser.add_argument('--baseline', help='exponents saved by an earlier --save')
+    parser.add_argument('--tolerance', type=float, default=0.5,
+                        help='allowed exponent growth over the baseline')
+    parser.add_argument('--save', metavar='FILE', help='write the fitted exponents')
+    parser.add_argument('--json', metavar='FILE', help='write all measurements')
+    parser.add_argument('families', nargs='*', help='families to run (default: all)')
+    argv = sys.argv[1:]
+    args = []
+    if '--' in argv:
+        args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    options = parser.parse_args(argv)
+    options.args = args
+    known = [name for name, _, _ in FAMILIES]
+    unknown = set(options.families) - set(known)
+    if unknown:
+        parser.error('unknown families %s; known: %s' % (', '.join(sorted(unknown)), ', '.join(known)))
+
+    baseline = {}
+    if options.baseline:
+        with open(options.baseline) as f:
+            baseline = json.load(f)
+    fitted = {}
+    measurements = {}
+    regressions = 0
+    print('%-11s %-15s %8s %6s %8s' % ('family', 'metric', 'exponent', 'r2', 'baseline'))
+    for family, generate, seed in FAMILIES:
+        if options.families and family not in options.families:
+            continue
+        points, timed_out = measure(options, family, generate, os.path.splitext(seed)[1])
+        measurements[family] = {'seed': seed, 'points': points, 'timeout': timed_out}
+        fitted[family] = exponents(points, options.fit_points)
+        for metric, (k, r2) in sorted(fitted[family].items()):
+            old = baseline.get(family, {}).get(metric)
+            flag = ''
+            if old is not None and k > old[0] + options.tolerance:
+                flag = '  REGRESSION'
+                regressions += 1
+            print('%-11s %-15s %8.2f %6.2f %8s%s' % (family, metric, k, r2,
+                                                     '%.2f' % old[0] if old else '-', flag))
+        if timed_out is not None:
+            old = baseline.get(family, {})
+            flag = ''
+            if old and ('timeout' not in old or timed_out < old['timeout']):
+                flag = '  REGRESSION'
+                regressions += 1
+            print('%-11s %-15s %8s %6s %8s%s' % (family, 'timeout', 'n=%d' % timed_out, '-',
+                                                 'n=%d' % old['timeout'] if 'timeout' in old else '-', flag))
+            fitted[family]['timeout'] = timed_out
+        sys.stdout.flush()
+
+    if options.save:
+        with open(options.save, 'w') as f:
+            json.dump(fitted, f, indent=1, sort_keys=True)
+    if options.json:
+        with open(options.json, 'w') as f:
+            json.dump({'exponents': fitted, 'measurements': measurements}, f, indent=1, sort_keys=True)
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,263 @@
+#!/usr/bin/env python3
+"""Share one corpus run between many workers and machines.
+
+The coordinator ('serve') owns the input list and the result store;
+workers ('work') pull one input at a time under a lease, run the
+analyser and report the result. The protocol is one JSON object per
+line over TCP:
+
+  worker -> {"op": "lease"}
+            <- {"lease": id, "input": path, "timeout": s, "ttl": s}
+            <- {"wait": s}       everything is leased, ask again later
+            <- {"done": true}    nothing left
+  worker -> {"op": "heartbeat", "lease": id}            <- {"ok": true}
+  worker -> {"op": "result", "lease": id, "result": {}} <- {"ok": true}
+
+A lease is handed back to the queue when its worker disconnects or
+stops sending heartbeats for --ttl seconds, so a killed worker or a
+rebooted box only delays its inputs. Results are appended to a JSON
+lines file; a restarted coordinator skips the inputs already in it.
+
+    tools/shard.py serve --results run.jsonl --files-from inputs.txt
+    tools/shard.py work --binary ./cppcheck -j8                      # on every box
+    tools/shard.py work --coordinator host:7457 --root /srv/corpus --binary ./cppcheck
+"""
+
+import argparse
+import collections
+import json
+import os
+import socket
+import socketserver
+import sys
+import threading
+import time
+
+import hangcorpus
+
+PORT = 7457
+
+
+class Coordinator(object):
+    def __init__(self, inputs, results, timeout, ttl):
+        self.lock = threading.Lock()
+        self.finished = threading.Event()
+        self.timeout = timeout
+        self.ttl = ttl
+        self.results = results
+        done = set()
+        if os.path.exists(results):
+            with open(results) as f:
+                done = set(json.loads(line)['input'] for line in f if line.strip())
+        self.queue = collections.deque(i for i in inputs if i not in done)
+        self.leases = {}        # id -> [input, owner, expiry]
+        self.completed = set()
+        self.next_lease = 1
+        self.counts = collections.Counter()
+        if not self.queue:
+            self.finished.set()
+
+    def lease(self, owner):
+        with self.lock:
+            self._expire()
+            if self.queue:
+                lease = self.next_lease
+                self.next_lease += 1
+                path = self.queue.popleft()
+                self.leases[lease] = [path, owner, time.time() + self.ttl]
+                return {'lease': lease, 'input': path, 'timeout': self.timeout, 'ttl': self.ttl}
+            if self.leases:
+                return {'wait': min(1.0, self.ttl / 3)}
+            return {'done': True}
+
+    def heartbeat(self, lease):
+        with self.lock:
+            if lease not in self.leases:
+                return {'error': 'lease %d expired' % lease}
+            self.leases[lease][2] = time.time() + self.ttl
+            return {'ok': True}
+
+    def result(self, lease, record):
+        with self.lock:
+            held = self.leases.pop(lease, None)
+            path = record.get('input') or (held and held[0])
+            # A late result of an expired lease still counts once.
+            if path and path not in self.completed:
+                if path in self.queue:
+                    self.queue.remove(path)
+                self.completed.add(path)
+                record['input'] = path
+                with open(self.results, 'a') as f:
+                    f.write(json.dumps(record, sort_keys=True) + '\n')
+                self.counts[record.get('status')] += 1
+            if not self.queue and not self.leases:
+                self.finished.set()
+            return {'ok': True}
+
+    def release(self, owner):
+        """Requeue the leases of a disconnected worker."""
+        with self.lock:
+            for lease, (path, holder, _) in list(self.leases.items()):
+                if holder == owner:
+                    del self.leases[lease]
+                    self.queue.appendleft(path)
+                    sys.stderr.write('requeued %s from %s\n' % (path, owner))
+
+    def _expire(self):
+        now = time.time()
+        for lease, (path, holder, expiry) in list(self.leases.items()):
+            if expiry < now:
+                del self.leases[lease]
+                self.queue.appendleft(path)
+                sys.stderr.write('lease of %s by %s expired\n' % (path, holder))
+
+
+class Handler(socketserver.StreamRequestHandler):
+    def handle(self):
+        coordinator = self.server.coordinator
+        owner = '%s:%d' % self.client_address
+        try:
+            for line in self.rfile:
+                message = json.loads(line.decode('utf-8'))
+                op = message.get('op')
+                if op == 'lease':
+                    reply = coordinator.lease(owner)
+                elif op == 'heartbeat':
+                    reply = coordinator.heartbeat(message['lease'])
+                elif op == 'result':
+                    reply = coordinator.result(message['lease'], message['result'])
+                else:
+                    reply = {'error': 'unknown op %r' % op}
+                self.wfile.write((json.dumps(reply) + '\n').encode('utf-8'))
+        except (ConnectionError, ValueError):
+            pass
+        finally:
+            coordinator.release(owner)
+
+
+class Server(socketserver.ThreadingTCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+def serve(options):
+    paths = options.files
+    if options.files_from:
+        stream = sys.stdin if options.files_from == '-' else open(options.files_from)
+        paths = [line.rstrip('\n') for line in stream if line.strip()]
+    paths = paths or [os.path.basename(p) for p in hangcorpus.corpus_files()]
+    coordinator = Coordinator(paths, options.results, options.timeout, options.ttl)
+    host, port = split_address(options.listen)
+    server = Server((host, port), Handler)
+    server.coordinator = coordinator
+    thread = threading.Thread(target=server.serve_forever)
+    thread.daemon = True
+    thread.start()
+    sys.stderr.write('serving %d inputs on %s:%d\n' % (len(coordinator.queue), host,
+                                                       server.server_address[1]))
+    while not coordinator.finished.wait(options.ttl):
+        with coordinator.lock:
+            coordinator._expire()
+    # Give connected workers a moment to hear 'done'.
+    time.sleep(min(2.0, options.ttl))
+    server.shutdown()
+    counts = coordinator.counts
+    print('%d results: %s -> %s' % (sum(counts.values()), ', '.join(
+        '%d %s' % (n, s) for s, n in sorted(counts.items())), options.results))
+    return 1 if counts['timeout'] or counts['crash'] else 0
+
+
+class Connection(object):
+    def __init__(self, address):
+        self.sock = socket.create_connection(split_address(address))
+        self.file = self.sock.makefile('rwb')
+        self.lock = threading.Lock()
+
+    def call(self, message):
+        with self.lock:
+            self.file.write((json.dumps(message) + '\n').encode('utf-8'))
+            self.file.flush()
+            line = self.file.readline()
+        if not line:
+            raise ConnectionError('coordinator closed the connection')
+        return json.loads(line.decode('utf-8'))
+
+
+def work_loop(options):
+    connection = Connection(options.coordinator)
+    count = 0
+    while True:
+        reply = connection.call({'op': 'lease'})
+        if reply.get('done'):
+            return count
+        if 'wait' in reply:
+            time.sleep(reply['wait'])
+            continue
+        lease = reply['lease']
+        path = reply['input']
+        local = os.path.join(options.root, path)
+        stop = threading.Event()
+
+        def beat():
+            while not stop.wait(reply['ttl'] / 3):
+                connection.call({'op': 'heartbeat', 'lease': lease})
+        beater = threading.Thread(target=beat)
+        beater.daemon = True
+        beater.start()
+        try:
+            result = hangcorpus.run(options.binary, local, options.args, timeout=reply['timeout'])
+        finally:
+            stop.set()
+            beater.join()
+        record = result.as_dict()
+        record['input'] = path
+        record['timeout'] = reply['timeout']
+        record['worker'] = socket.gethostname()
+        connection.call({'op': 'result', 'lease': lease, 'result': record})
+        count += 1
+
+
+def split_address(address):
+    host, _, port = address.rpartition(':')
+    return host or '127.0.0.1', int(port)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    sub = parser.add_subparsers(dest='command', required=True)
+    p = sub.add_parser('serve', help='hand out inputs and collect results')
+    p.add_argument('--listen', default='127.0.0.1:%d' % PORT, metavar='HOST:PORT')
+    p.add_argument('--results', default='shard-results.jsonl', help='JSON lines result store')
+    p.add_argument('--files-from', metavar='FILE', help="read inputs from FILE, '-' for stdin")
+    p.add_argument('--timeout', type=float, default=60.0, help='seconds per input')
+    p.add_argument('--ttl', type=float, default=30.0, help='lease lifetime without a heartbeat')
+    p.add_argument('files', nargs='*', help='inputs (default: the whole corpus)')
+    p = sub.add_parser('work', help='analyse inputs leased from a coordinator')
+    p.add_argument('--coordinator', default='127.0.0.1:%d' % PORT, metavar='HOST:PORT')
+    p.add_argument('--binary', required=True, help='cppcheck binary')
+    p.add_argument('--root', default=hangcorpus.CORPUS_DIR,
+                   help='directory relative inputs are resolved against')
+    p.add_argument('-j', '--jobs', type=int, default=1, help='parallel connections')
+    argv = sys.argv[1:]
+    args = []
+    if '--' in argv:
+        args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    options = parser.parse_args(argv)
+    options.args = args
+
+    if options.command == 'serve':
+        return serve(options)
+    counts = []
+    threads = [threading.Thread(target=lambda: counts.append(work_loop(options)))
+               for _ in range(options.jobs)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    print('%d inputs analysed' % sum(counts))
+    return 0 if len(counts) == len(threads) else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""Startup latency, from exec() to a tiny file analysed, split into phases.
+
+For hang8.cpp (12 bytes) all of the run is startup. Every phase is a
+separate run that stops a little later than the previous one, so the
+differences of their mean wall times are the phase costs:
+
+  loader         dynamic loader, LD_DEBUG=statistics (cycles, reported
+                 separately, glibc does not give seconds)
+  process        cppcheck --version: loader, static initialisation and
+                 option parsing
+  configuration  an empty file: Settings, std.cfg and the Library
+  tiny file      hang8.cpp: preprocessing, tokenizing and checking a
+                 tiny file, where the checks have next to nothing to do
+  libraries      the empty file again with --library= for every .cfg
+                 in the cfg/ next to --binary (where cppcheck loads them
+                 from), the way editor integrations launch cppcheck once
+                 per batch of keystrokes
+
+    tools/startup.py --binary ./cppcheck
+    tools/startup.py --binary ./cppcheck --runs 50 --history startup.json
+    tools/startup.py --binary ./cppcheck --libraries qt,wxwidgets,boost
+
+With --history the result is appended to a JSON file keyed by --label
+(default: the --version output), and each phase is printed next to
+the latest earlier entry of another build.
+"""
+
+import argparse
+import datetime
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+import benchstats
+import hangcorpus
+
+_LOADER = re.compile(r'total startup time in dynamic loader: (\d+) cycles')
+_RELOCATIONS = re.compile(r'\bnumber of relocations: (\d+)')
+
+
+def version(binary):
+    proc = subprocess.run([binary, '--version'], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    return proc.stdout.decode('utf-8', 'replace').strip()
+
+
+def libraries(options):
+    if options.libraries is not None:
+        return [name for name in options.libraries.split(',') if name]
+    cfg_dir = os.path.join(os.path.dirname(os.path.abspath(options.binary)), 'cfg')
+    try:
+        names = os.listdir(cfg_dir)
+    except OSError:
+        return []
+    return sorted(name[:-4] for name in names if name.endswith('.cfg') and name != 'std.cfg')
+
+
+def loader_stats(options):
+    """Median loader cycles and the relocation count of --version."""
+    cycles = []
+    relocations = None
+    env = dict(os.environ, LD_DEBUG='statistics')
+    for _ in range(options.runs):
+        result = hangcorpus.run(options.binary, '--version', timeout=options.timeout, env=env)
+        m = _LOADER.search(result.stderr)
+        if not m:
+            return None
+        cycles.append(int(m.group(1)))
+        m = _RELOCATIONS.search(result.stderr)
+        relocations = int(m.group(1)) if m else None
+    cycles.sort()
+    return {'cycles': cycles[len(cycles) // 2], 'relocations': relocations}
+
+
+def measure(options, path, args):
+    """Wall and CPU seconds of --runs runs of one phase."""
+    for _ in range(options.warmup):
+        hangcorpus.run(options.binary, path, args, timeout=options.timeout)
+    walls = []
+    cpus = []
+    for _ in range(options.runs):
+        result = hangcorpus.run(options.binary, path, args, timeout=options.timeout)
+        if result.status != 'ok':
+            raise RuntimeError('%s %s: %s after %.1fs' % (' '.join(args), path, result.status, result.wall))
+        walls.append(result.wall)
+        cpus.append(result.cpu)
+    wall, ci = benchstats.mean_ci(walls, options.confidence)
+    return {'wall': wall, 'ci': ci, 'cpu': sum(cpus) / len(cpus), 'samples': walls}
+
+
+def previous(history, label):
+    for entry in reversed(history):
+        if entry['label'] != label:
+            return entry
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--binary', required=True, help='cppcheck binary')
+    parser.add_argument('--runs', type=int, default=20, help='measured runs per phase')
+    parser.add_argument('--warmup', type=int, default=3, help='unmeasured runs per phase')
+    parser.add_argument('--confidence', type=float, default=0.95)
+    parser.add_argument('--timeout', type=float, default=60.0, help='seconds per run')
+    parser.add_argument('--libraries', metavar='A,B,...',
+                        help='libraries of the large configuration (default: every .cfg but std)')
+    parser.add_argument('--history', metavar='FILE', help='append the result to this JSON history')
+    parser.add_argument('--label', help='build name in the history (default: the --version output)')
+    argv = sys.argv[1:]
+    args = []
+    if '--' in argv:
+        args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    options = parser.parse_args(argv)
+    options.args = args
+    if options.runs < 2:
+        parser.error('--runs must be at least 2 for a confidence interval')
+
+    label = options.label or version(options.binary)
+    libs = libraries(options)
+    phases = {}
+    with tempfile.TemporaryDirectory() as tmp:
+        empty = os.path.join(tmp, 'empty.cpp')
+        open(empty, 'w').close()
+        phases['process'] = measure(options, '--version', [])
+        phases['configuration'] = measure(options, empty, options.args)
+        phases['tiny file'] = measure(options, os.path.join(hangcorpus.CORPUS_DIR, 'hang8.cpp'),
+                                      options.args)
+        if libs:
+            phases['libraries'] = measure(options, empty,
+                                          ['--library=' + name for name in libs] + options.args)
+    loader = loader_stats(options)
+
+    history = []
+    if options.history and os.path.exists(options.history):
+        with open(options.history) as f:
+            history = json.load(f)
+    before = previous(history, label)
+
+    base = {'process': None, 'configuration': 'process', 'tiny file': 'configuration',
+            'libraries': 'configuration'}
+    print('%-14s %14s %10s %10s %12s' % ('phase', 'wall ms', 'phase ms', 'cpu ms', 'before ms'))
+    for name in ('process', 'configuration', 'tiny file', 'libraries'):
+        if name not in phases:
+            continue
+        data = phases[name]
+        delta = data['wall'] - (phases[base[name]]['wall'] if base[name] else 0.0)
+        data['phase'] = delta
+        old = before['phases'].get(name) if before else None
+        print('%-14s %8.2f±%-5.2f %10.2f %10.2f %12s' % (
+            name, 1000 * data['wall'], 1000 * data['ci'], 1000 * delta, 1000 * data['cpu'],
+            '%.2f' % (1000 * old['wall']) if old else '-'))
+    if libs:
+        print('(libraries: %d configurations)' % len(libs))
+    if loader:
+        print('loader: %d cycles, %s relocations' % (loader['cycles'], loader['relocations']))
+    if before:
+        print('before: %s (%s)' % (before['label'], before['date']))
+
+    if options.history:
+        history.append({
+            'label': label,
+            'binary': os.path.abspath(options.binary),
+            'args': options.args,
+            'date': datetime.datetime.now(datetime.timezone.utc).isoformat(timespec='seconds'),
+            'libraries': libs,
+            'loader': loader,
+            'phases': phases,
+        })
+        with open(options.history, 'w') as f:
+            json.dump(history, f, indent=1, sort_keys=True)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
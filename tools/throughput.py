@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""Lines and tokens per second on the real-world corpus files.
+
+hang.cpp (DieHard allocator), hang19.cpp (tesseract GenericVector /
+IndexMapBiDi) and hang11.cpp (LLVM NVPTXutil) are production code, not
+fuzzer output, so their throughput is the closest proxy for analysing
+a real code base. Each file is analysed --warmup times unmeasured, then
+--trials times with --showtime=summary; every trial gives seconds per
+stage (hangcorpus.stage_times), from which lines/s and tokens/s are
+derived. Means are reported with t confidence intervals:
+
+    tools/throughput.py --binary ./cppcheck --json throughput.json
+    tools/throughput.py --binary ./cppcheck --trials 30 hang19.cpp -- --std=c++11
+
+The JSON holds the raw samples as well as the summaries, for
+dashboards that want to plot them. Token counts come from the
+hangcorpus lexer, not from cppcheck, so they are comparable between
+builds but not identical to the analyser's token list.
+"""
+
+import argparse
+import datetime
+import json
+import os
+import subprocess
+import sys
+
+import benchstats
+import hangcorpus
+
+FILES = ('hang.cpp', 'hang19.cpp', 'hang11.cpp')
+
+
+def summary(samples, confidence):
+    mean, ci = benchstats.mean_ci(samples, confidence)
+    return {'mean': mean, 'ci': ci, 'samples': samples}
+
+
+def bench(options, path):
+    text = hangcorpus.read_source(path)
+    lines = text.count('\n') + (not text.endswith('\n'))
+    tokens = len(hangcorpus.tokenize(text))
+    args = ['--showtime=summary'] + options.args
+    for _ in range(options.warmup):
+        hangcorpus.run(options.binary, path, args, timeout=options.timeout)
+    walls = []
+    stages = dict((stage, []) for stage in ('total',) + hangcorpus.STAGES)
+    for _ in range(options.trials):
+        result = hangcorpus.run(options.binary, path, args, timeout=options.timeout)
+        if result.status != 'ok':
+            raise RuntimeError('%s: %s after %.1fs' % (path, result.status, result.wall))
+        walls.append(result.wall)
+        timers = hangcorpus.parse_showtime(result.stdout)
+        times = hangcorpus.stage_times(timers)
+        times['total'] = hangcorpus.total_time(timers)
+        for stage in stages:
+            stages[stage].append(times[stage])
+
+    report = {'lines': lines, 'tokens': tokens, 'trials': options.trials,
+              'wall': summary(walls, options.confidence), 'stages': {}}
+    for stage, seconds in stages.items():
+        if not any(seconds):
+            continue
+        rates = [(lines / s, tokens / s) for s in seconds if s > 0]
+        report['stages'][stage] = {
+            'seconds': summary(seconds, options.confidence),
+            'lines_per_s': summary([r[0] for r in rates], options.confidence),
+            'tokens_per_s': summary([r[1] for r in rates], options.confidence),
+        }
+    return report
+
+
+def version(binary):
+    proc = subprocess.run([binary, '--version'], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    return proc.stdout.decode('utf-8', 'replace').strip()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--binary', required=True, help='cppcheck binary')
+    parser.add_argument('--warmup', type=int, default=2, help='unmeasured runs per file')
+    parser.add_argument('--trials', type=int, default=10, help='measured runs per file')
+    parser.add_argument('--confidence', type=float, default=0.95)
+    parser.add_argument('--timeout', type=float, default=600.0, help='seconds per run')
+    parser.add_argument('--json', metavar='FILE', help='write the report as JSON')
+    parser.add_argument('files', nargs='*', help='files (default: %s)' % ' '.join(FILES))
+    argv = sys.argv[1:]
+    args = []
+    if '--' in argv:
+        args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    options = parser.parse_args(argv)
+    options.args = args
+    if options.trials < 2:
+        parser.error('--trials must be at least 2 for a confidence interval')
+
+    paths = options.files or [os.path.join(hangcorpus.CORPUS_DIR, name) for name in FILES]
+    report = {
+        'binary': os.path.abspath(options.binary),
+        'version': version(options.binary),
+        'args': options.args,
+        'date': datetime.datetime.now(datetime.timezone.utc).isoformat(timespec='seconds'),
+        'confidence': options.confidence,
+        'files': {},
+    }
+    print('%-11s %-15s %12s %16s %18s' % ('file', 'stage', 'seconds', 'lines/s', 'tokens/s'))
+    for path in paths:
+        name = os.path.basename(path)
+        result = report['files'][name] = bench(options, path)
+        for stage, data in sorted(result['stages'].items(), key=lambda i: -i[1]['seconds']['mean']):
+            print('%-11s %-15s %7.3f±%.3f %9.0f±%-6.0f %10.0f±%-7.0f' % (
+                name, stage, data['seconds']['mean'], data['seconds']['ci'],
+                data['lines_per_s']['mean'], data['lines_per_s']['ci'],
+                data['tokens_per_s']['mean'], data['tokens_per_s']['ci']))
+        print('%-11s %-15s %7.3f±%.3f   (%d lines, %d tokens)' % (
+            name, 'wall', result['wall']['mean'], result['wall']['ci'], result['lines'], result['tokens']))
+        sys.stdout.flush()
+    if options.json:
+        with open(options.json, 'w') as f:
+            json.dump(report, f, indent=1, sort_keys=True)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
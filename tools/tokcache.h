@@ -0,0 +1,160 @@
+/*
+ * Zero-copy reader for the token caches written by tools/tokcache.py.
+ *
+ * The cache is mapped read-only; token strings are stored with their
+ * length (a string or char literal may contain NULs) and a trailing NUL
+ * inside the mapping, so nothing is copied or parsed until the caller
+ * builds its own tokens. Loading a cached file into cppcheck replaces reading
+ * and preprocessing the source with one pass over the records:
+ *
+ *     tokcache::Cache cache("corpus.htok");
+ *     const tokcache::File *file = cache.find("hang19.cpp");
+ *     std::vector<Token *> tokens;
+ *     for (const tokcache::TokenRecord *t = cache.begin(*file); t != cache.end(*file); ++t) {
+ *         tokenlist.addtoken(cache.str(*t), t->line, 0);
+ *         tokens.push_back(tokenlist.back());
+ *     }
+ *     for (std::size_t i = 0; i < tokens.size(); ++i)
+ *         if (cache.begin(*file)[i].link > (int)i)
+ *             Token::createMutualLinks(tokens[i], tokens[cache.begin(*file)[i].link]);
+ *
+ * after which Tokenizer::simplifyTokenList1() can run directly. Compare
+ * File::sha1 with the source before trusting a cache that may be stale.
+ */
+
+#ifndef TOKCACHE_H
+#define TOKCACHE_H
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tokcache {
+
+    enum Kind { Op = 0, Name = 1, Number = 2, String = 3, Char = 4 };
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t fileCount;
+        uint32_t reserved;
+        uint64_t stringsOffset;
+        uint64_t stringsSize;
+        uint64_t filesOffset;
+        uint64_t tokensOffset;
+        uint64_t tokenCount;
+    };
+
+    struct File {
+        uint32_t name;
+        uint32_t firstToken;
+        uint32_t tokenCount;
+        uint32_t reserved;
+        unsigned char sha1[20];
+        unsigned char padding[12];
+    };
+
+    struct TokenRecord {
+        uint32_t str;
+        uint32_t line;
+        uint16_t column;
+        uint8_t kind;
+        uint8_t flags;
+        int32_t link;       // file relative index of the matching bracket, -1 if none
+    };
+
+    class Cache {
+    public:
+        explicit Cache(const char *path) : mData(0), mSize(0) {
+            const int fd = ::open(path, O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error(std::string("cannot open ") + path);
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(Header)) {
+                mSize = (std::size_t)st.st_size;
+                void *p = ::mmap(0, mSize, PROT_READ, MAP_SHARED, fd, 0);
+                mData = p == MAP_FAILED ? 0 : static_cast<const char *>(p);
+            }
+            ::close(fd);
+            if (!mData || std::memcmp(header().magic, "HTOK", 4) != 0 || header().version != 2) {
+                release();
+                throw std::runtime_error(std::string(path) + ": not a version 2 token cache");
+            }
+        }
+
+        ~Cache() {
+            release();
+        }
+
+        const Header &header() const {
+            return *reinterpret_cast<const Header *>(mData);
+        }
+
+        std::size_t fileCount() const {
+            return header().fileCount;
+        }
+
+        const File &file(std::size_t i) const {
+            return reinterpret_cast<const File *>(mData + header().filesOffset)[i];
+        }
+
+        /** Linear search by name; the corpus has a few hundred files at most. */
+        const File *find(const char *name) const {
+            for (std::size_t i = 0; i < fileCount(); ++i) {
+                if (strSize(file(i).name) == std::strlen(name) &&
+                    std::memcmp(strData(file(i).name), name, std::strlen(name)) == 0)
+                    return &file(i);
+            }
+            return 0;
+        }
+
+        /** Bytes of a string; NUL terminated, but may contain NULs itself. */
+        const char *strData(uint32_t offset) const {
+            return mData + header().stringsOffset + offset;
+        }
+
+        std::size_t strSize(uint32_t offset) const {
+            uint32_t length;
+            std::memcpy(&length, strData(offset) - sizeof(length), sizeof(length));
+            return length;
+        }
+
+        std::string str(uint32_t offset) const {
+            return std::string(strData(offset), strSize(offset));
+        }
+
+        std::string str(const TokenRecord &tok) const {
+            return str(tok.str);
+        }
+
+        const TokenRecord *begin(const File &f) const {
+            return reinterpret_cast<const TokenRecord *>(mData + header().tokensOffset) + f.firstToken;
+        }
+
+        const TokenRecord *end(const File &f) const {
+            return begin(f) + f.tokenCount;
+        }
+
+    private:
+        Cache(const Cache &);
+        Cache &operator=(const Cache &);
+
+        void release() {
+            if (mData)
+                ::munmap(const_cast<char *>(mData), mSize);
+            mData = 0;
+        }
+
+        const char *mData;
+        std::size_t mSize;
+    };
+}
+
+#endif // TOKCACHE_H
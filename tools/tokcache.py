@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""Pre-tokenized binary corpus cache (.htok).
+
+Reducer and fuzzer loops analyse the same seeds again and again, and
+re-lexing hang.cpp or hang19.cpp every time is wasted work. This tool
+writes the token stream of every input once, in a layout that
+tools/tokcache.h maps read-only and walks without copying or parsing:
+
+  header    'HTOK' u32 version, u32 files, u32 0, u64 strings offset,
+            u64 strings size, u64 files offset, u64 tokens offset,
+            u64 tokens
+  strings   deduplicated token and file names, each as u32 length,
+            the bytes and a NUL; a string offset points at the bytes
+            (strings may contain NULs, as in hang90.c and hang99.cpp)
+  files     count x 48 bytes: u32 name, u32 first token, u32 tokens,
+            u32 0, sha1 of the source (20 bytes), 12 bytes padding
+  tokens    count x 16 bytes: u32 string, u32 line, u16 column,
+            u8 kind, u8 flags, i32 link (file relative index of the
+            matching bracket, -1 if none)
+
+All integers are little endian and every section is 8-byte aligned.
+With --binary the stream is the output of 'cppcheck -E', so #include
+and macro handling is done once, and #line markers keep the original
+line numbers; without it the raw file is lexed.
+
+    tools/tokcache.py build corpus.htok
+    tools/tokcache.py build --binary ./cppcheck corpus.htok hang.cpp hang19.cpp
+    tools/tokcache.py dump corpus.htok hang95.cpp
+"""
+
+import argparse
+import hashlib
+import mmap
+import os
+import struct
+import subprocess
+import sys
+
+import hangcorpus
+
+MAGIC = b'HTOK'
+VERSION = 2
+
+KINDS = ('op', 'name', 'number', 'string', 'char')
+
+HEADER = struct.Struct('<4sIII QQQQQ')
+FILE = struct.Struct('<IIII20s12x')
+TOKEN = struct.Struct('<IIHBBi')
+LENGTH = struct.Struct('<I')
+
+_OPENING = {'(': ')', '[': ']', '{': '}'}
+
+
+def _align(out):
+    out.write(b'\0' * (-out.tell() % 8))
+
+
+def source_tokens(path, binary=None):
+    """Return (text, tokens) of path, preprocessed by binary if given."""
+    text = hangcorpus.read_source(path)
+    if not binary:
+        return text, hangcorpus.tokenize(text)
+    proc = subprocess.run([binary, '-E', path], stdout=subprocess.PIPE,
+                          stderr=subprocess.DEVNULL)
+    tokens = hangcorpus.tokenize(proc.stdout.decode('latin-1'))
+    # Drop '#line N "file"' markers and renumber the tokens after them.
+    out = []
+    shift = 0
+    i = 0
+    while i < len(tokens):
+        t = tokens[i]
+        if (t.str == '#' and i + 2 < len(tokens) and tokens[i + 1].str == 'line'
+                and tokens[i + 2].kind == 'number'):
+            shift = int(tokens[i + 2].str) - t.line - 1
+            i += 3
+            if i < len(tokens) and tokens[i].kind == 'string' and tokens[i].line == t.line:
+                i += 1
+            continue
+        t.line += shift
+        out.append(t)
+        i += 1
+    return text, out
+
+
+def links(tokens):
+    result = [-1] * len(tokens)
+    stack = []
+    for i, t in enumerate(tokens):
+        if t.str in _OPENING:
+            stack.append(i)
+        elif t.str in (')', ']', '}'):
+            if stack and _OPENING[tokens[stack[-1]].str] == t.str:
+                j = stack.pop()
+                result[i] = j
+                result[j] = i
+    return result
+
+
+def build(path, inputs, binary=None):
+    strings = {}
+    blob = bytearray()
+
+    def intern(s):
+        offset = strings.get(s)
+        if offset is None:
+            data = s.encode('latin-1')
+            blob.extend(LENGTH.pack(len(data)))
+            offset = strings[s] = len(blob)
+            blob.extend(data + b'\0')
+        return offset
+
+    files = []
+    records = []
+    for source in inputs:
+        text, tokens = source_tokens(source, binary)
+        linked = links(tokens)
+        files.append((intern(os.path.basename(source)), len(records), len(tokens),
+                      hashlib.sha1(text.encode('latin-1')).digest()))
+        for t, link in zip(tokens, linked):
+            records.append((intern(t.str), t.line, min(t.col, 0xffff), KINDS.index(t.kind), 0, link))
+
+    with open(path + '.tmp', 'wb') as out:
+        out.write(b'\0' * HEADER.size)
+        _align(out)
+        strings_offset = out.tell()
+        out.write(blob)
+        _align(out)
+        files_offset = out.tell()
+        for name, first, count, digest in files:
+            out.write(FILE.pack(name, first, count, 0, digest))
+        tokens_offset = out.tell()
+        for record in records:
+            out.write(TOKEN.pack(*record))
+        out.seek(0)
+        out.write(HEADER.pack(MAGIC, VERSION, len(files), 0, strings_offset, len(blob),
+                              files_offset, tokens_offset, len(records)))
+    os.replace(path + '.tmp', path)
+    return len(files), len(records), len(blob)
+
+
+class Cache(object):
+    """mmap view of a cache, mirroring tools/tokcache.h."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        (magic, version, self.file_count, _, self.strings, _, self.files, self.tokens,
+         self.token_count) = HEADER.unpack_from(self.map, 0)
+        if magic != MAGIC or version != VERSION:
+            raise ValueError('%s: not a version %d token cache' % (path, VERSION))
+
+    def string(self, offset):
+        start = self.strings + offset
+        length, = LENGTH.unpack_from(self.map, start - LENGTH.size)
+        return self.map[start:start + length].decode('latin-1')
+
+    def file(self, i):
+        name, first, count, _, digest = FILE.unpack_from(self.map, self.files + i * FILE.size)
+        return self.string(name), first, count, digest
+
+    def token(self, i):
+        string, line, column, kind, flags, link = TOKEN.unpack_from(
+            self.map, self.tokens + i * TOKEN.size)
+        return self.string(string), line, column, KINDS[kind], link
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    sub = parser.add_subparsers(dest='command', required=True)
+    p = sub.add_parser('build', help='write a cache')
+    p.add_argument('--binary', help="preprocess with '<binary> -E'")
+    p.add_argument('cache')
+    p.add_argument('files', nargs='*', help='inputs (default: the whole corpus)')
+    p = sub.add_parser('dump', help='print the cached tokens of files')
+    p.add_argument('cache')
+    p.add_argument('names', nargs='*', help='file names (default: list the files)')
+    options = parser.parse_args()
+
+    if options.command == 'build':
+        count, tokens, strings = build(options.cache, options.files or hangcorpus.corpus_files(),
+                                       options.binary)
+        print('%d files, %d tokens, %d bytes of strings -> %s' % (count, tokens, strings, options.cache))
+        return 0
+
+    cache = Cache(options.cache)
+    for i in range(cache.file_count):
+        name, first, count, digest = cache.file(i)
+        if not options.names:
+            print('%-12s %8d tokens  %s' % (name, count, digest.hex()))
+            continue
+        if name not in options.names:
+            continue
+        for n in range(count):
+            text, line, column, kind, link = cache.token(first + n)
+            print('%6d %4d:%-4d %-7s %-5s %s' % (n, line, column, kind,
+                                                 link if link >= 0 else '', text))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,215 @@
+/*
+ * tokenbench - cost of inserting and retagging tokens.
+ *
+ *     g++ -O2 -Ilib -Itools -o tokenbench tools/tokenbench.cpp $LIB_OBJECTS
+ *     tools/tokcache.py build corpus.htok
+ *     ./tokenbench corpus.htok hang60.cpp hang93.cpp
+ *     ./tokenbench --tokens 2000000 --repeat 9 corpus.htok hang60.cpp
+ *
+ * ($LIB_OBJECTS: the lib object files of a cppcheck build.)
+ *
+ * The tokens of each named file are read from a tools/tokcache.py cache
+ * (unmatched brackets dropped so every copy is balanced) and used as a
+ * template body, which is instantiated until --tokens tokens exist, the
+ * way hang60.cpp and hang93.cpp blow up:
+ *
+ *   expand      Token::insertToken plus Token::createMutualLinks for
+ *               brackets, one body after the other, as
+ *               TemplateSimplifier::expandTemplate does
+ *   copy        Tokenizer::copyTokens of the whole body
+ *   retag KIND  Token::str() assignment of a KIND string (op, name,
+ *               number, string, char) to every expanded token, i.e.
+ *               Token::update_property_info alone
+ *
+ * Each workload runs --repeat times on a fresh list and the fastest run
+ * is reported in ns per token, which keeps the figure stable enough to
+ * compare two builds of the token classification. List destruction is
+ * not timed.
+ */
+
+#include "settings.h"
+#include "token.h"
+#include "tokenize.h"
+#include "tokenlist.h"
+
+#include "tokcache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stack>
+#include <string>
+#include <vector>
+
+namespace {
+    const char * const KINDS[] = { "op", "name", "number", "string", "char" };
+    const std::size_t KIND_COUNT = sizeof(KINDS) / sizeof(KINDS[0]);
+
+    struct Body {
+        std::vector<std::string> strings;
+        std::vector<unsigned int> kinds;
+    };
+
+    bool isBracket(const std::string &s)
+    {
+        return s.size() == 1 && std::strchr("()[]{}", s[0]);
+    }
+
+    bool opens(const std::string &s)
+    {
+        return s == "(" || s == "[" || s == "{";
+    }
+
+    Body load(const tokcache::Cache &cache, const tokcache::File &file)
+    {
+        Body body;
+        for (const tokcache::TokenRecord *t = cache.begin(file); t != cache.end(file); ++t) {
+            const std::string s = cache.str(*t);
+            if (isBracket(s) && t->link < 0)
+                continue;
+            body.strings.push_back(s);
+            body.kinds.push_back(t->kind < KIND_COUNT ? t->kind : 0);
+        }
+        return body;
+    }
+
+    double elapsed(const std::chrono::steady_clock::time_point &start)
+    {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /** Inserts body after dst until count tokens exist, linking brackets. */
+    Token *expand(Token *dst, const Body &body, std::size_t count)
+    {
+        std::stack<Token *> brackets;
+        for (std::size_t n = 0; n < count;) {
+            for (std::size_t i = 0; i < body.strings.size() && n < count; ++i, ++n) {
+                dst->insertToken(body.strings[i]);
+                dst = dst->next();
+                if (!isBracket(body.strings[i]))
+                    continue;
+                if (opens(body.strings[i])) {
+                    brackets.push(dst);
+                } else if (!brackets.empty()) {
+                    Token::createMutualLinks(brackets.top(), dst);
+                    brackets.pop();
+                }
+            }
+        }
+        return dst;
+    }
+
+    /** ns per token for each workload: expand, copy, retag per kind. */
+    std::vector<double> measure(const Settings &settings, const Body &body, std::size_t count)
+    {
+        std::vector<double> ns;
+
+        TokenList expanded(&settings);
+        expanded.appendFileIfNew("tokenbench.cpp");
+        expanded.addtoken(";", 1, 0);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        expand(expanded.front(), body, count);
+        ns.push_back(elapsed(start) / count);
+
+        TokenList source(&settings);
+        source.appendFileIfNew("tokenbench.cpp");
+        source.addtoken(";", 1, 0);
+        expand(source.front(), body, body.strings.size());
+        TokenList copied(&settings);
+        copied.appendFileIfNew("tokenbench.cpp");
+        copied.addtoken(";", 1, 0);
+        Token *dst = copied.front();
+        const std::size_t copies = (count + body.strings.size() - 1) / body.strings.size();
+        start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < copies; ++i)
+            dst = Tokenizer::copyTokens(dst, source.front()->next(), source.back());
+        ns.push_back(elapsed(start) / (copies * body.strings.size()));
+
+        // Give every expanded token the string of a body token of each kind,
+        // rotating through the body so the old strings vary as well.
+        for (unsigned int kind = 0; kind < KIND_COUNT; ++kind) {
+            std::vector<const std::string *> strings;
+            for (std::size_t i = 0; i < body.strings.size(); ++i) {
+                if (body.kinds[i] == kind)
+                    strings.push_back(&body.strings[i]);
+            }
+            if (strings.empty()) {
+                ns.push_back(-1.0);
+                continue;
+            }
+            std::size_t i = 0;
+            start = std::chrono::steady_clock::now();
+            for (Token *tok = expanded.front()->next(); tok; tok = tok->next()) {
+                tok->str(*strings[i]);
+                if (++i == strings.size())
+                    i = 0;
+            }
+            ns.push_back(elapsed(start) / count);
+        }
+        return ns;
+    }
+
+    void usage()
+    {
+        std::cerr << "usage: tokenbench [--tokens N] [--repeat N] cache-file corpus-file...\n";
+        std::exit(2);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t count = 500000;
+    unsigned int repeat = 5;
+    std::vector<const char *> args;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--tokens") == 0 && i + 1 < argc)
+            count = std::strtoul(argv[++i], 0, 10);
+        else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+            repeat = static_cast<unsigned int>(std::strtoul(argv[++i], 0, 10));
+        else if (argv[i][0] == '-')
+            usage();
+        else
+            args.push_back(argv[i]);
+    }
+    if (args.size() < 2 || !count || !repeat)
+        usage();
+
+    const tokcache::Cache cache(args[0]);
+    const Settings settings;
+    std::printf("%-12s %8s %9s %9s", "file", "body", "expand", "copy");
+    for (std::size_t k = 0; k < KIND_COUNT; ++k)
+        std::printf(" %9s", KINDS[k]);
+    std::printf("   (ns per token, best of %u)\n", repeat);
+    for (std::size_t f = 1; f < args.size(); ++f) {
+        const tokcache::File *file = cache.find(args[f]);
+        if (!file) {
+            std::cerr << "tokenbench: " << args[f] << " is not in " << args[0] << '\n';
+            return 1;
+        }
+        const Body body = load(cache, *file);
+        if (body.strings.empty()) {
+            std::printf("%-12s %8s\n", args[f], "empty");
+            continue;
+        }
+        std::vector<double> best;
+        for (unsigned int r = 0; r < repeat; ++r) {
+            const std::vector<double> ns = measure(settings, body, count);
+            if (best.empty())
+                best = ns;
+            for (std::size_t i = 0; i < ns.size(); ++i)
+                best[i] = std::min(best[i], ns[i]);
+        }
+        std::printf("%-12s %8zu", args[f], body.strings.size());
+        for (std::size_t i = 0; i < best.size(); ++i) {
+            if (best[i] < 0)
+                std::printf(" %9s", "-");
+            else
+                std::printf(" %9.1f", best[i]);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}